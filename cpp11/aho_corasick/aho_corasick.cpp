@@ -0,0 +1,354 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <map>
+#include <regex>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Searching a text for many keywords with one
+// 'regex_search' per keyword reads the text once
+// per keyword. An Aho-Corasick automaton finds all
+// occurrences of all keywords in a single pass:
+//
+// 1. The keywords are put into a trie.
+// 2. Each trie node gets a failure link to the
+//    longest proper suffix of its path that is also
+//    a path in the trie (computed breadth-first).
+// 3. Failure links are folded into a complete
+//    transition table, so scanning costs one table
+//    lookup per byte -- no failure chasing.
+//
+// The table is kept compact: bytes that occur in
+// no keyword share a single column, and states are
+// 32-bit row offsets into one contiguous array.
+//
+class aho_corasick {
+public:
+    struct match {
+        size_t pattern;     // Index into the keyword list.
+        size_t offset;      // Where the occurrence starts.
+    };
+
+    explicit aho_corasick(const vector<string>& patterns) : lengths_(patterns.size()) {
+        build_alphabet(patterns);
+        build_trie(patterns);
+        build_table();
+    }
+
+    // Calls 'on_match(match)' for every occurrence, in order of end position.
+    template<typename F>
+    void scan(const char* first, const char* last, F on_match) const {
+        const uint32_t* table = table_.data();
+        uint32_t row = 0;
+        for (const char* p = first; p != last; ++p) {
+            row = table[row + class_of_[static_cast<unsigned char>(*p)]];
+            if (row & output_flag) {
+                row &= ~output_flag;
+                report(row / columns_, static_cast<size_t>(p + 1 - first), on_match);
+            }
+        }
+    }
+
+    vector<match> find_all(const string& text) const {
+        vector<match> matches;
+        scan(text.data(), text.data() + text.size(), [&matches](const match& m) { matches.push_back(m); });
+        return matches;
+    }
+
+    size_t state_count() const { return state_count_; }
+    size_t column_count() const { return columns_; }
+    size_t table_bytes() const { return table_.size() * sizeof(uint32_t); }
+
+private:
+    // Marks table entries whose target state has outputs.
+    static const uint32_t output_flag = 0x80000000u;
+
+    void build_alphabet(const vector<string>& patterns) {
+        bool used[256] = {};
+        for (const string& p : patterns) {
+            for (char c : p) {
+                used[static_cast<unsigned char>(c)] = true;
+            }
+        }
+        columns_ = 1;   // Column 0: bytes in no keyword.
+        for (int c = 0; c < 256; ++c) {
+            class_of_[c] = used[c] ? static_cast<uint8_t>(columns_++) : 0;
+        }
+    }
+
+    void build_trie(const vector<string>& patterns) {
+        trie_.push_back(trie_node{});
+        for (size_t id = 0; id < patterns.size(); ++id) {
+            assert(!patterns[id].empty());
+            uint32_t s = 0;
+            for (char c : patterns[id]) {
+                uint8_t col = class_of_[static_cast<unsigned char>(c)];
+                auto it = trie_[s].next.find(col);
+                if (it == trie_[s].next.end()) {
+                    trie_.push_back(trie_node{});
+                    it = trie_[s].next.insert(make_pair(col, static_cast<uint32_t>(trie_.size() - 1))).first;
+                }
+                s = it->second;
+            }
+            trie_[s].outputs.push_back(id);
+            lengths_[id] = patterns[id].size();
+        }
+        state_count_ = trie_.size();
+        if (state_count_ * columns_ >= output_flag) {
+            throw length_error{"aho_corasick: too many states"};
+        }
+    }
+
+    void build_table() {
+        vector<uint32_t> fail(trie_.size(), 0);
+        dict_link_.assign(trie_.size(), no_state);
+        table_.assign(trie_.size() * columns_, 0);
+
+        // Breadth-first, so that failure targets are complete before use.
+        queue<uint32_t> todo;
+        for (auto& edge : trie_[0].next) {
+            table_[edge.first] = edge.second;
+            todo.push(edge.second);
+        }
+        while (!todo.empty()) {
+            uint32_t s = todo.front();
+            todo.pop();
+            uint32_t f = fail[s];
+            dict_link_[s] = trie_[f].outputs.empty() ? dict_link_[f] : f;
+            for (size_t col = 0; col < columns_; ++col) {
+                auto it = trie_[s].next.find(static_cast<uint8_t>(col));
+                if (it != trie_[s].next.end()) {
+                    fail[it->second] = table_[f * columns_ + col] & ~output_flag;
+                    table_[s * columns_ + col] = it->second;
+                    todo.push(it->second);
+                } else {
+                    table_[s * columns_ + col] = table_[f * columns_ + col] & ~output_flag;
+                }
+            }
+        }
+
+        // Flatten outputs; mark transitions into states that report something.
+        out_first_.resize(trie_.size() + 1);
+        for (size_t s = 0; s < trie_.size(); ++s) {
+            out_first_[s] = static_cast<uint32_t>(outputs_.size());
+            outputs_.insert(outputs_.end(), trie_[s].outputs.begin(), trie_[s].outputs.end());
+        }
+        out_first_[trie_.size()] = static_cast<uint32_t>(outputs_.size());
+        for (uint32_t& target : table_) {
+            uint32_t s = target;
+            if (!trie_[s].outputs.empty() || dict_link_[s] != no_state) {
+                target = s | output_flag;
+            }
+        }
+        // Rows are addressed by offset, which saves a multiplication per byte.
+        for (uint32_t& target : table_) {
+            target = (target & output_flag) | ((target & ~output_flag) * static_cast<uint32_t>(columns_));
+        }
+        trie_.clear();
+        trie_.shrink_to_fit();
+    }
+
+    template<typename F>
+    void report(uint32_t s, size_t end, F& on_match) const {
+        for (; s != no_state; s = dict_link_[s]) {
+            for (uint32_t i = out_first_[s]; i != out_first_[s + 1]; ++i) {
+                size_t id = outputs_[i];
+                on_match(match{id, end - lengths_[id]});
+            }
+        }
+    }
+
+    static const uint32_t no_state = 0xffffffffu;
+
+    struct trie_node {
+        map<uint8_t, uint32_t> next;
+        vector<size_t> outputs;
+    };
+
+    vector<trie_node> trie_;            // Only needed while building.
+    uint8_t class_of_[256];
+    size_t columns_ = 0;
+    size_t state_count_ = 0;
+    vector<uint32_t> table_;
+    vector<uint32_t> dict_link_;        // Nearest suffix state with outputs.
+    vector<uint32_t> out_first_;
+    vector<size_t> outputs_;
+    vector<size_t> lengths_;
+};
+
+const uint32_t aho_corasick::output_flag;
+const uint32_t aho_corasick::no_state;
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_aho_corasick_basic() {
+    // The classic example: keywords that overlap and contain each other.
+    aho_corasick ac{{ "he", "she", "his", "hers" }};
+    auto matches = ac.find_all("ushers");
+
+    // "she" and "he" end at 4, "hers" at 6.
+    assert(matches.size() == 3);
+    assert(matches[0].pattern == 1 && matches[0].offset == 1);
+    assert(matches[1].pattern == 0 && matches[1].offset == 2);
+    assert(matches[2].pattern == 3 && matches[2].offset == 2);
+}
+
+
+void test_aho_corasick_log_line() {
+    const string line("2024-01-01 12:00:00 ERROR disk full, WARN retry, ERROR giving up");
+    const vector<string> keywords{ "ERROR", "WARN", "FATAL", "disk" };
+    aho_corasick ac{keywords};
+    vector<size_t> counts(keywords.size());
+    for (auto& m : ac.find_all(line)) {
+        ++counts[m.pattern];
+        assert(line.compare(m.offset, keywords[m.pattern].size(), keywords[m.pattern]) == 0);
+    }
+    assert((counts == vector<size_t>{2, 1, 0, 1}));
+}
+
+
+void test_aho_corasick_vs_find() {
+    // Duplicate keywords and single characters are fine, too.
+    const vector<string> patterns{ "a", "aa", "aab", "b", "ab", "aab", "zzz" };
+    const string text("aabaaabzaab");
+    aho_corasick ac{patterns};
+
+    vector<pair<size_t, size_t>> expected;    // (offset, pattern)
+    for (size_t id = 0; id < patterns.size(); ++id) {
+        for (size_t pos = text.find(patterns[id]); pos != string::npos; pos = text.find(patterns[id], pos + 1)) {
+            expected.push_back(make_pair(pos, id));
+        }
+    }
+    vector<pair<size_t, size_t>> actual;
+    for (auto& m : ac.find_all(text)) {
+        actual.push_back(make_pair(m.offset, m.pattern));
+    }
+    sort(expected.begin(), expected.end());
+    sort(actual.begin(), actual.end());
+    assert(actual == expected);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: 10/100/10K keywords over log-like
+// text, Aho-Corasick vs. one 'regex_search' per
+// keyword and line. Run with 'make bench'; pass
+// the text size in MiB as second argument.
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+static string random_word(unsigned& seed, size_t min_len, size_t max_len) {
+    seed = seed * 1103515245 + 12345;
+    size_t len = min_len + (seed >> 16) % (max_len - min_len + 1);
+    string w;
+    for (size_t i = 0; i < len; ++i) {
+        seed = seed * 1103515245 + 12345;
+        w += static_cast<char>('a' + (seed >> 16) % 26);
+    }
+    return w;
+}
+
+
+void bench_aho_corasick(size_t mib) {
+    unsigned seed = 42;
+    vector<string> vocabulary;
+    for (int i = 0; i < 20000; ++i) {
+        vocabulary.push_back(random_word(seed, 4, 10));
+    }
+    // Log lines built from the vocabulary, so some keywords do occur.
+    vector<string> lines;
+    size_t bytes = 0;
+    while (bytes < mib * 1024 * 1024) {
+        string line = "2024-01-01 12:00:00";
+        for (int w = 0; w < 8; ++w) {
+            seed = seed * 1103515245 + 12345;
+            line += ' ';
+            line += vocabulary[(seed >> 8) % vocabulary.size()];
+        }
+        bytes += line.size() + 1;
+        lines.push_back(line);
+    }
+    string text;
+    for (auto& line : lines) {
+        text += line;
+        text += '\n';
+    }
+    const double mb = text.size() / 1e6;
+
+    cout << "MB/s over " << mib << " MiB of log lines" << endl;
+    cout << setw(10) << "keywords" << setw(12) << "states" << setw(12) << "table KiB"
+         << setw(14) << "aho_corasick" << setw(14) << "regex/line" << setw(12) << "find/kw" << endl;
+    for (size_t count : { size_t(10), size_t(100), size_t(10000) }) {
+        vector<string> keywords(vocabulary.begin(), vocabulary.begin() + count);
+        aho_corasick ac{keywords};
+
+        size_t n_ac = 0;
+        double t_ac = seconds([&] {
+            ac.scan(text.data(), text.data() + text.size(), [&n_ac](const aho_corasick::match&) { ++n_ac; });
+        });
+
+        // One regex_search per keyword and line; on a sample, as it's slow.
+        vector<regex> regexes(keywords.begin(), keywords.end());
+        size_t sample_lines = max<size_t>(1, min(lines.size(), 2000000 / (count * 50)));
+        size_t sample_bytes = 0, n_re = 0;
+        double t_re = seconds([&] {
+            for (size_t i = 0; i < sample_lines; ++i) {
+                sample_bytes += lines[i].size() + 1;
+                for (auto& re : regexes) {
+                    n_re += regex_search(lines[i], re);
+                }
+            }
+        });
+
+        // One string::find pass per keyword over the whole text.
+        size_t n_find = 0;
+        size_t find_keywords = min<size_t>(count, 100);
+        double t_find = seconds([&] {
+            for (size_t k = 0; k < find_keywords; ++k) {
+                for (size_t pos = text.find(keywords[k]); pos != string::npos; pos = text.find(keywords[k], pos + 1)) {
+                    ++n_find;
+                }
+            }
+        }) * count / find_keywords;     // Extrapolated beyond 100 keywords.
+        (void)n_re;
+
+        cout << fixed << setprecision(2) << setw(10) << count << setw(12) << ac.state_count()
+             << setw(12) << ac.table_bytes() / 1024 << setw(14) << mb / t_ac
+             << setw(14) << sample_bytes / 1e6 / t_re << setw(12) << mb / t_find
+             << "  (" << n_ac << " matches)" << endl;
+        assert(count > find_keywords || n_find == n_ac);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_aho_corasick_basic();
+    test_aho_corasick_log_line();
+    test_aho_corasick_vs_find();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_aho_corasick(argc > 2 ? strtoul(argv[2], nullptr, 10) : 64);
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <atomic>
+#include <limits>
+#include <list>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'alignas' and 'aligned_storage' align objects
+// whose size is known at compile-time; 'std::align'
+// aligns a pointer into a buffer. A 'vector', on
+// the other hand, gets its memory from
+// 'std::allocator', which (before C++17) only
+// guarantees 'alignof(max_align_t)', 16 bytes.
+//
+// 'aligned_allocator<T, Align>' over-allocates by
+// 'Align' bytes plus room for a pointer, uses
+// 'std::align' to find the aligned address in
+// there, and stores the pointer it got from
+// 'operator new' just before that address, so
+// 'deallocate' can find it again.
+//
+// 'aligned_vector<T, Align>' is a 'vector' with
+// that allocator; with the default of 64 bytes, its
+// data starts on a cache line. SIMD loads of 16 or
+// 32 bytes then never straddle two cache lines.
+//
+// 'cache_padded<T>' aligns and pads a T to a whole
+// cache line. Per-thread counters or slots stored
+// next to each other in an array otherwise share
+// cache lines: each write by one thread takes the
+// line away from all the others, although they
+// never touch the same data ("false sharing").
+// Over-aligned types need an 'aligned_vector' in
+// C++11, as 'std::allocator' ignores 'alignas'.
+//
+const size_t cache_line_size = 64;
+
+
+template<typename T, size_t Align = cache_line_size>
+class aligned_allocator {
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0, "alignment must be a power of two");
+    static_assert(Align >= alignof(T), "alignment must not be less than the type's");
+
+public:
+    typedef T value_type;
+
+    // 'allocator_traits' can only rebind type parameters by itself.
+    template<typename U>
+    struct rebind {
+        typedef aligned_allocator<U, Align> other;
+    };
+
+    aligned_allocator() noexcept { }
+
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Align>&) noexcept { }
+
+    T* allocate(size_t n) {
+        const size_t header = sizeof(void*);
+        if (n > (numeric_limits<size_t>::max() - header - Align) / sizeof(T)) {
+            throw bad_alloc{};
+        }
+        size_t space = n * sizeof(T) + header + Align - 1;
+        void* original = ::operator new(space);
+
+        // Leave room for the original pointer in front of the aligned address.
+        void* aligned = static_cast<char*>(original) + header;
+        space -= header;
+        align(Align, n * sizeof(T), aligned, space);
+        memcpy(static_cast<char*>(aligned) - header, &original, header);
+        return static_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        void* original;
+        memcpy(&original, reinterpret_cast<char*>(p) - sizeof(void*), sizeof(void*));
+        ::operator delete(original);
+    }
+};
+
+template<typename T, typename U, size_t Align>
+bool operator==(const aligned_allocator<T, Align>&, const aligned_allocator<U, Align>&) { return true; }
+
+template<typename T, typename U, size_t Align>
+bool operator!=(const aligned_allocator<T, Align>&, const aligned_allocator<U, Align>&) { return false; }
+
+
+template<typename T, size_t Align = cache_line_size>
+using aligned_vector = vector<T, aligned_allocator<T, Align>>;
+
+
+template<typename T, size_t Size = cache_line_size>
+struct alignas(Size) cache_padded {
+private:
+    template<typename... Args>
+    struct is_padded : false_type { };
+
+    template<typename Arg>
+    struct is_padded<Arg> : is_same<typename decay<Arg>::type, cache_padded> { };
+
+public:
+    cache_padded() : value() { }
+
+    // Not for a single 'cache_padded', which would otherwise be forwarded
+    // to T instead of being copied.
+    template<typename... Args, typename = typename enable_if<!is_padded<Args...>::value>::type>
+    explicit cache_padded(Args&&... args) : value(std::forward<Args>(args)...) { }
+
+    T& operator*() { return value; }
+    const T& operator*() const { return value; }
+    T* operator->() { return &value; }
+    const T* operator->() const { return &value; }
+
+    T value;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+static bool is_aligned(const void* p, size_t align) {
+    return reinterpret_cast<uintptr_t>(p) % align == 0;
+}
+
+
+void test_aligned_vector() {
+    aligned_vector<float> floats(3, 1.5f);
+    assert(is_aligned(floats.data(), 64));
+    // Stays aligned when the vector grows.
+    for (int i = 0; i < 1000; ++i) {
+        floats.push_back(static_cast<float>(i));
+        assert(is_aligned(floats.data(), 64));
+    }
+    assert(floats[2] == 1.5f && floats.back() == 999.0f);
+
+    aligned_vector<char, 4096> page(10);
+    assert(is_aligned(page.data(), 4096));
+    aligned_vector<double, 32> doubles(1);
+    assert(is_aligned(doubles.data(), 32));
+
+    // Node-based containers rebind the allocator to their node type.
+    list<int, aligned_allocator<int, 128>> numbers{1, 2, 3};
+    for (const int& n : numbers) {
+        assert(is_aligned(&n, 8));
+    }
+
+    aligned_allocator<int> a;
+    aligned_allocator<double> b(a);
+    assert(a == b);
+    try {
+        a.allocate(numeric_limits<size_t>::max() / 2);
+        assert(false);
+    } catch (const bad_alloc&) {
+    }
+}
+
+
+void test_cache_padded() {
+    static_assert(sizeof(cache_padded<char>) == 64, "one cache line");
+    static_assert(alignof(cache_padded<char>) == 64, "on a cache line");
+    static_assert(sizeof(cache_padded<char[100]>) == 128, "padded to whole cache lines");
+
+    aligned_vector<cache_padded<long>> slots(4);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        assert(is_aligned(&slots[i], 64) && *slots[i] == 0);
+        *slots[i] = static_cast<long>(i);
+    }
+    assert(reinterpret_cast<char*>(&slots[1]) - reinterpret_cast<char*>(&slots[0]) == 64);
+
+    cache_padded<pair<int, string>> p(7, "seven");
+    assert(p->first == 7 && (*p).second == "seven");
+
+    // Copies, also from non-const lvalues.
+    cache_padded<long> a(5);
+    cache_padded<long> b(a);
+    const cache_padded<long> c(b);
+    cache_padded<long> d(std::move(a));
+    assert(*b == 5 && *c == 5 && *d == 5);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark:
+// 1. Summing floats with 32-byte (AVX) or 16-byte
+//    (SSE) loads from a cache-line-aligned buffer
+//    vs. the same buffer shifted by 4 bytes, where
+//    every other AVX load crosses a cache line.
+// 2. Threads that each increment their own counter,
+//    with the counters next to each other vs.
+//    'cache_padded'.
+// Run with 'make bench'.
+//
+#if defined(__SSE2__)
+static float sum_sse(const float* p, size_t n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+    for (size_t i = 0; i + 16 <= n; i += 16) {
+        s0 = _mm_add_ps(s0, _mm_loadu_ps(p + i));
+        s1 = _mm_add_ps(s1, _mm_loadu_ps(p + i + 4));
+        s2 = _mm_add_ps(s2, _mm_loadu_ps(p + i + 8));
+        s3 = _mm_add_ps(s3, _mm_loadu_ps(p + i + 12));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx")))
+static float sum_avx(const float* p, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+    for (size_t i = 0; i + 32 <= n; i += 32) {
+        s0 = _mm256_add_ps(s0, _mm256_loadu_ps(p + i));
+        s1 = _mm256_add_ps(s1, _mm256_loadu_ps(p + i + 8));
+        s2 = _mm256_add_ps(s2, _mm256_loadu_ps(p + i + 16));
+        s3 = _mm256_add_ps(s3, _mm256_loadu_ps(p + i + 24));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+    float sum = 0;
+    for (float lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+#endif
+
+
+template<typename F>
+static double ns_per_op(size_t ops, F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+
+void bench_simd_loads() {
+#if defined(__SSE2__)
+    bool has_avx = __builtin_cpu_supports("avx");
+    cout << "ns per 1K floats summed" << endl;
+    cout << setw(22) << "" << setw(12) << "aligned" << setw(12) << "+4 bytes" << endl;
+    // 16 KiB fits into L1, 64 MiB doesn't fit into any cache.
+    for (size_t n : { size_t(4096), size_t(16) * 1024 * 1024 }) {
+        aligned_vector<float> data(n + 32, 1.0f);
+        const size_t total = 256 * 1024 * 1024;
+        const size_t rounds = total / n;
+        for (int avx = 0; avx <= (has_avx ? 1 : 0); ++avx) {
+            float sums[2] = { 0, 0 };
+            double times[2];
+            for (int shift = 0; shift <= 1; ++shift) {
+                const float* p = data.data() + shift;
+                times[shift] = ns_per_op(total / 1024, [&] {
+                    for (size_t r = 0; r < rounds; ++r) {
+                        sums[shift] += avx ? sum_avx(p, n) : sum_sse(p, n);
+                        asm volatile("" : : : "memory");
+                    }
+                });
+            }
+            assert(sums[0] == sums[1]);
+            string label = string(avx ? "AVX, " : "SSE, ") + (n * sizeof(float) < 1024 * 1024 ? "16 KiB" : "64 MiB");
+            cout << fixed << setprecision(1) << setw(22) << label << setw(12) << times[0] << setw(12) << times[1] << endl;
+        }
+    }
+#endif
+}
+
+
+template<typename Counter>
+double bench_counters(unsigned threads, size_t increments) {
+    aligned_vector<Counter> counters(threads);
+    double ns = ns_per_op(threads * increments, [&] {
+        vector<thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&counters, t, increments] {
+                atomic<uint64_t>& counter = *counters[t];
+                for (size_t i = 0; i < increments; ++i) {
+                    // A plain load and store, no locked instruction.
+                    counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+    for (auto& counter : counters) {
+        assert((*counter).load() == increments);
+    }
+    return ns;
+}
+
+
+// An 'atomic' that can be dereferenced like 'cache_padded', but isn't padded.
+struct packed_counter {
+    packed_counter() : value(0) { }
+    atomic<uint64_t>& operator*() { return value; }
+    atomic<uint64_t> value;
+};
+
+
+void bench_false_sharing() {
+    const size_t increments = 20000000;
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    cout << "ns per increment, one counter per thread, " << hardware << " hardware threads" << endl;
+    cout << setw(10) << "threads" << setw(12) << "adjacent" << setw(16) << "cache_padded" << endl;
+    for (unsigned threads = 1; threads <= max(4u, hardware); threads *= 2) {
+        double adjacent = bench_counters<packed_counter>(threads, increments);
+        double padded = bench_counters<cache_padded<atomic<uint64_t>>>(threads, increments);
+        cout << fixed << setprecision(2) << setw(10) << threads << setw(12) << adjacent << setw(16) << padded << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_aligned_vector();
+    test_cache_padded();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_simd_loads();
+        bench_false_sharing();
+    }
+
+    return 0;
+}
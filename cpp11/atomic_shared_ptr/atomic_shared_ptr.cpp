@@ -0,0 +1,299 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Sharing a 'shared_ptr' between threads. Copying
+// a 'shared_ptr' is thread-safe, but reading and
+// writing the *same* 'shared_ptr' object from
+// different threads is a data race. C++11 offers
+// 'atomic_load'/'atomic_store' overloads for
+// 'shared_ptr', but libstdc++ implements them with
+// a pool of mutexes.
+//
+// 'shared_ptr_cell' publishes immutable snapshots
+// (e. g. configuration objects) without locks,
+// using a "split reference count":
+//
+// - The cell holds a 64-bit word: a pointer to a
+//   node (low 48 bits) that owns the 'shared_ptr',
+//   plus a count of readers currently inside 'load'
+//   (high 16 bits).
+// - 'load' bumps that count with a single
+//   'fetch_add', copies the 'shared_ptr' out of the
+//   node and then gives the count back.
+// - 'store' swaps in a new node and transfers the
+//   outstanding reader count of the old node to the
+//   node's own counter. The last one out deletes it.
+//
+// Readers never wait for a writer: a concurrent
+// 'store' at most turns the reader's give-back
+// into a decrement of the old node's counter.
+//
+template<typename T>
+class shared_ptr_cell {
+public:
+    shared_ptr_cell() : shared_ptr_cell{shared_ptr<T>{}} { }
+
+    explicit shared_ptr_cell(shared_ptr<T> value)
+        : word_{pack(new node{std::move(value)}, 0)} {
+    }
+
+    shared_ptr_cell(const shared_ptr_cell&) = delete;
+    shared_ptr_cell& operator=(const shared_ptr_cell&) = delete;
+
+    ~shared_ptr_cell() {
+        delete unpack_node(word_.load(memory_order_acquire));
+    }
+
+    shared_ptr<T> load() const {
+        // Announce our presence; this keeps the node alive.
+        uint64_t word = word_.fetch_add(one_reader, memory_order_acquire);
+        node* n = unpack_node(word);
+        shared_ptr<T> result = n->value;
+        word += one_reader;
+
+        // Leave again. If the node is still installed, just decrement the
+        // reader count in the word...
+        while (unpack_node(word) == n) {
+            if (word_.compare_exchange_weak(word, word - one_reader,
+                                            memory_order_release, memory_order_relaxed)) {
+                return result;
+            }
+        }
+        // ...otherwise a writer has moved our count to the node.
+        release(n, -1);
+        return result;
+    }
+
+    void store(shared_ptr<T> value) {
+        node* fresh = new node{std::move(value)};
+        uint64_t old = word_.exchange(pack(fresh, 0), memory_order_acq_rel);
+        release(unpack_node(old), static_cast<int64_t>(old >> pointer_bits));
+    }
+
+private:
+    static_assert(sizeof(void*) == 8, "pointer packing assumes 64-bit pointers");
+
+    static const int pointer_bits = 48;
+    static const uint64_t pointer_mask = (uint64_t{1} << pointer_bits) - 1;
+    static const uint64_t one_reader = uint64_t{1} << pointer_bits;
+
+    struct node {
+        explicit node(shared_ptr<T> v) : value{std::move(v)} { }
+
+        const shared_ptr<T> value;
+        // Net count of readers that still have to leave the node once it
+        // has been swapped out. The writer adds, the readers subtract, so
+        // it may go negative for a while; whoever brings it to zero frees
+        // the node.
+        atomic<int64_t> pending{0};
+    };
+
+    static uint64_t pack(node* n, uint64_t readers) {
+        uint64_t bits = reinterpret_cast<uintptr_t>(n);
+        assert((bits & ~pointer_mask) == 0);
+        return bits | (readers << pointer_bits);
+    }
+
+    static node* unpack_node(uint64_t word) {
+        return reinterpret_cast<node*>(static_cast<uintptr_t>(word & pointer_mask));
+    }
+
+    static void release(node* n, int64_t delta) {
+        if (n->pending.fetch_add(delta, memory_order_acq_rel) + delta == 0) {
+            delete n;
+        }
+    }
+
+    mutable atomic<uint64_t> word_;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+struct config {
+    static atomic<int> alive;
+
+    explicit config(int v) : version{v} { ++alive; }
+    ~config() { --alive; }
+
+    int version;
+    char settings[256];
+};
+
+atomic<int> config::alive{0};
+
+
+void test_cell_basic() {
+    {
+    shared_ptr_cell<config> cell{make_shared<config>(1)};
+    shared_ptr<config> snapshot = cell.load();
+    assert(snapshot->version == 1);
+    assert(snapshot.use_count() == 2);  // Cell + snapshot.
+
+    cell.store(make_shared<config>(2));
+    assert(cell.load()->version == 2);
+
+    // The old snapshot stays valid for as long as someone holds it.
+    assert(snapshot->version == 1);
+    assert(config::alive == 2);
+    snapshot.reset();
+    assert(config::alive == 1);
+
+    // Empty cells work, too.
+    cell.store(nullptr);
+    assert(!cell.load());
+    }
+    assert(config::alive == 0);
+}
+
+
+void test_cell_concurrent() {
+    {
+    shared_ptr_cell<config> cell{make_shared<config>(0)};
+    atomic<bool> done{false};
+    const int versions = 2000;
+
+    vector<thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&cell, &done] {
+            int last_seen = 0;
+            while (!done) {
+                shared_ptr<config> snapshot = cell.load();
+                // Versions are published in order, so they never go back.
+                assert(snapshot->version >= last_seen);
+                last_seen = snapshot->version;
+            }
+        });
+    }
+    thread writer{[&cell, &done] {
+        for (int v = 1; v <= versions; ++v) {
+            cell.store(make_shared<config>(v));
+        }
+        done = true;
+    }};
+    writer.join();
+    for (auto& r : readers) {
+        r.join();
+    }
+    assert(cell.load()->version == versions);
+    assert(config::alive == 1);
+    }
+    // No node or config leaked.
+    assert(config::alive == 0);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: many readers, one writer that
+// publishes a new snapshot every 100 us.
+// Run with 'make bench'.
+//
+class mutex_cell {
+public:
+    explicit mutex_cell(shared_ptr<config> value) : value_{std::move(value)} { }
+
+    shared_ptr<config> load() const {
+        lock_guard<mutex> lock{mutex_};
+        return value_;
+    }
+
+    void store(shared_ptr<config> value) {
+        lock_guard<mutex> lock{mutex_};
+        value_ = std::move(value);
+    }
+
+private:
+    mutable mutex mutex_;
+    shared_ptr<config> value_;
+};
+
+
+class free_function_cell {
+public:
+    explicit free_function_cell(shared_ptr<config> value) : value_{std::move(value)} { }
+
+    shared_ptr<config> load() const { return atomic_load(&value_); }
+    void store(shared_ptr<config> value) { atomic_store(&value_, std::move(value)); }
+
+private:
+    shared_ptr<config> value_;
+};
+
+
+// Returns millions of loads per second, summed over all readers.
+template<typename Cell>
+static double read_throughput(unsigned reader_count) {
+    Cell cell{make_shared<config>(0)};
+    atomic<bool> done{false};
+    atomic<uint64_t> total{0};
+
+    vector<thread> readers;
+    for (unsigned i = 0; i < reader_count; ++i) {
+        readers.emplace_back([&] {
+            uint64_t loads = 0;
+            int sum = 0;
+            while (!done.load(memory_order_relaxed)) {
+                for (int k = 0; k < 64; ++k) {
+                    sum += cell.load()->version;
+                }
+                loads += 64;
+            }
+            total += loads + (sum == -1);
+        });
+    }
+    thread writer{[&] {
+        for (int v = 1; !done; ++v) {
+            cell.store(make_shared<config>(v));
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }};
+
+    const double seconds = 0.5;
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    done = true;
+    writer.join();
+    for (auto& r : readers) {
+        r.join();
+    }
+    return total / seconds / 1e6;
+}
+
+
+void bench_shared_ptr_cell() {
+    unsigned max_readers = max(8u, thread::hardware_concurrency());
+    cout << "million loads/s with one writer" << endl;
+    cout << setw(8) << "readers" << setw(12) << "split-rc" << setw(14) << "atomic_load" << setw(10) << "mutex" << endl;
+    for (unsigned readers = 1; readers <= max_readers; readers *= 2) {
+        cout << fixed << setprecision(1) << setw(8) << readers
+             << setw(12) << read_throughput<shared_ptr_cell<config>>(readers)
+             << setw(14) << read_throughput<free_function_cell>(readers)
+             << setw(10) << read_throughput<mutex_cell>(readers) << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_cell_basic();
+    test_cell_concurrent();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_shared_ptr_cell();
+    }
+
+    return 0;
+}
@@ -0,0 +1,1693 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'std::regex' in libstdc++ is a backtracking
+// matcher: its run-time can explode on unlucky
+// patterns and its recursion can overflow the
+// stack on long inputs. This chapter implements
+// a small engine for the subset of ECMAScript
+// that the 'regex' chapter uses, with run-time
+// linear in the length of the text:
+//
+// 1. The pattern is parsed into a syntax tree.
+// 2. The tree is compiled into a Thompson NFA.
+// 3. The NFA is turned into a DFA lazily: DFA
+//    states (ordered sets of NFA states) are only
+//    built when the text actually reaches them,
+//    and are cached for the next time.
+//
+// Supported syntax: literals, '.', escapes
+// ('\d', '\D', '\s', '\S', '\w', '\W', '\n', '\t',
+// '\.' etc.), bracket expressions ('[a-z]',
+// '[^,\s]'), '|', capturing and non-capturing
+// ('(?:...)') groups, and the quantifiers '*', '+',
+// '?' -- greedy or lazy. The 'icase' flag is
+// honored for ASCII letters. Anchors, back-
+// references and counted repetition are rejected
+// with 'regex_error'.
+//
+// Matches follow ECMAScript's leftmost-first
+// semantics, i. e. the results are the same as the
+// ones of 'std::regex'.
+//
+namespace dfa {
+
+using flag_type = regex_constants::syntax_option_type;
+using byte_set = bitset<256>;
+
+
+//////////////////////////////////////////////////
+// Parsing.
+//
+struct ast_node {
+    enum kind_type { chars, empty, concat, alternate, star, plus, quest, group };
+
+    kind_type kind;
+    byte_set set;               // 'chars' only.
+    int group_index = -1;       // 'group' only.
+    bool greedy = true;         // Quantifiers only.
+    vector<int> children;
+};
+
+
+class parser {
+public:
+    parser(const string& pattern, bool icase, vector<ast_node>& nodes)
+        : pattern_(pattern), icase_{icase}, nodes_(nodes) {
+    }
+
+    // Returns the index of the root node.
+    int parse() {
+        int root = parse_alternation();
+        if (pos_ != pattern_.size()) {
+            throw regex_error{regex_constants::error_paren};
+        }
+        return root;
+    }
+
+    int group_count() const { return groups_; }
+
+private:
+    int add(ast_node::kind_type kind) {
+        ast_node node;
+        node.kind = kind;
+        nodes_.push_back(node);
+        return static_cast<int>(nodes_.size() - 1);
+    }
+
+    bool at_end() const { return pos_ == pattern_.size(); }
+    char peek() const { return pattern_[pos_]; }
+
+    int parse_alternation() {
+        int first = parse_concat();
+        if (at_end() || peek() != '|') {
+            return first;
+        }
+        int alt = add(ast_node::alternate);
+        nodes_[alt].children.push_back(first);
+        while (!at_end() && peek() == '|') {
+            ++pos_;
+            int next = parse_concat();
+            nodes_[alt].children.push_back(next);
+        }
+        return alt;
+    }
+
+    int parse_concat() {
+        vector<int> items;
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            items.push_back(parse_repeat());
+        }
+        if (items.empty()) {
+            return add(ast_node::empty);
+        }
+        if (items.size() == 1) {
+            return items[0];
+        }
+        int cat = add(ast_node::concat);
+        nodes_[cat].children = items;
+        return cat;
+    }
+
+    int parse_repeat() {
+        int atom = parse_atom();
+        while (!at_end()) {
+            ast_node::kind_type kind;
+            switch (peek()) {
+            case '*': kind = ast_node::star; break;
+            case '+': kind = ast_node::plus; break;
+            case '?': kind = ast_node::quest; break;
+            case '{': throw regex_error{regex_constants::error_complexity};  // Not supported.
+            default: return atom;
+            }
+            ++pos_;
+            int rep = add(kind);
+            nodes_[rep].children.push_back(atom);
+            if (!at_end() && peek() == '?') {
+                nodes_[rep].greedy = false;
+                ++pos_;
+            }
+            atom = rep;
+        }
+        return atom;
+    }
+
+    int parse_atom() {
+        char c = pattern_[pos_++];
+        switch (c) {
+        case '(': {
+            int index = -1;
+            if (pattern_.compare(pos_, 2, "?:") == 0) {
+                pos_ += 2;
+            } else {
+                index = ++groups_;
+            }
+            int body = parse_alternation();
+            if (at_end() || peek() != ')') {
+                throw regex_error{regex_constants::error_paren};
+            }
+            ++pos_;
+            if (index < 0) {
+                return body;
+            }
+            int g = add(ast_node::group);
+            nodes_[g].group_index = index;
+            nodes_[g].children.push_back(body);
+            return g;
+        }
+        case '[':
+            return add_chars(parse_bracket());
+        case '.': {
+            byte_set any;
+            any.set();
+            any.reset('\n');
+            any.reset('\r');
+            return add_chars(any);
+        }
+        case '\\':
+            return add_chars(parse_escape());
+        case '*': case '+': case '?': case '{':
+            throw regex_error{regex_constants::error_badrepeat};
+        case ')':
+            throw regex_error{regex_constants::error_paren};
+        case '^': case '$':
+            throw regex_error{regex_constants::error_complexity};  // Not supported.
+        default: {
+            byte_set single;
+            single.set(static_cast<unsigned char>(c));
+            return add_chars(fold_case(single));
+        }
+        }
+    }
+
+    int add_chars(const byte_set& set) {
+        int n = add(ast_node::chars);
+        nodes_[n].set = set;
+        return n;
+    }
+
+    // For 'icase', adds the other case of each ASCII letter. Sets are folded
+    // before they're negated: '[^a]' mustn't match 'A' either.
+    byte_set fold_case(byte_set set) const {
+        if (icase_) {
+            for (int c = 'a'; c <= 'z'; ++c) {
+                if (set[c] || set[c - 'a' + 'A']) {
+                    set.set(c);
+                    set.set(c - 'a' + 'A');
+                }
+            }
+        }
+        return set;
+    }
+
+    // Called after the backslash.
+    byte_set parse_escape() {
+        if (at_end()) {
+            throw regex_error{regex_constants::error_escape};
+        }
+        char c = pattern_[pos_++];
+        byte_set set;
+        switch (c) {
+        case 'd': case 'D':
+            for (int ch = '0'; ch <= '9'; ++ch) set.set(ch);
+            break;
+        case 's': case 'S':
+            for (char ch : string(" \t\n\r\f\v")) set.set(static_cast<unsigned char>(ch));
+            break;
+        case 'w': case 'W':
+            for (int ch = 0; ch < 256; ++ch) {
+                if (isalnum(ch) || ch == '_') set.set(ch);
+            }
+            break;
+        case 'n': set.set('\n'); return set;
+        case 't': set.set('\t'); return set;
+        case 'r': set.set('\r'); return set;
+        case 'f': set.set('\f'); return set;
+        case 'v': set.set('\v'); return set;
+        default:
+            if (isalnum(static_cast<unsigned char>(c))) {
+                // Back-references, '\b' and friends.
+                throw regex_error{regex_constants::error_escape};
+            }
+            set.set(static_cast<unsigned char>(c));
+            return fold_case(set);
+        }
+        set = fold_case(set);
+        if (isupper(static_cast<unsigned char>(c))) {
+            set.flip();
+        }
+        return set;
+    }
+
+    // Called after the opening bracket.
+    byte_set parse_bracket() {
+        byte_set set;
+        bool negate = !at_end() && peek() == '^';
+        if (negate) {
+            ++pos_;
+        }
+        bool first = true;
+        while (true) {
+            if (at_end()) {
+                throw regex_error{regex_constants::error_brack};
+            }
+            char c = pattern_[pos_++];
+            if (c == ']' && !first) {
+                break;
+            }
+            first = false;
+            if (c == '\\') {
+                set |= parse_escape();
+                continue;
+            }
+            if (pos_ + 1 < pattern_.size() && peek() == '-' && pattern_[pos_ + 1] != ']') {
+                char hi = pattern_[pos_ + 1];
+                pos_ += 2;
+                if (hi < c) {
+                    throw regex_error{regex_constants::error_range};
+                }
+                for (int ch = static_cast<unsigned char>(c); ch <= static_cast<unsigned char>(hi); ++ch) {
+                    set.set(ch);
+                }
+                continue;
+            }
+            set.set(static_cast<unsigned char>(c));
+        }
+        set = fold_case(set);
+        if (negate) {
+            set.flip();
+        }
+        return set;
+    }
+
+    const string& pattern_;
+    const bool icase_;
+    vector<ast_node>& nodes_;
+    size_t pos_ = 0;
+    int groups_ = 0;
+};
+
+
+//////////////////////////////////////////////////
+// Thompson NFA. Every state either consumes one
+// byte out of a set, forks ('split', 'out' has
+// priority over 'out1'), records a capture
+// position ('save') or accepts ('match').
+//
+struct nfa {
+    enum op_type { consume, split, save, match };
+
+    struct state {
+        op_type op;
+        int out;
+        int out1;
+        int arg;                // Set index for 'consume', slot for 'save'.
+    };
+
+    vector<state> states;
+    vector<byte_set> sets;
+    int start = -1;
+
+    int add(op_type op, int out = -1, int out1 = -1, int arg = 0) {
+        states.push_back(state{op, out, out1, arg});
+        return static_cast<int>(states.size() - 1);
+    }
+};
+
+
+class nfa_compiler {
+public:
+    // A reversed NFA matches the reversed language; it has no captures.
+    nfa_compiler(const vector<ast_node>& nodes, bool reversed, nfa& out)
+        : nodes_(nodes), reversed_{reversed}, nfa_(out) {
+    }
+
+    void compile(int root) {
+        int accept = nfa_.add(nfa::match);
+        if (reversed_) {
+            nfa_.start = compile(root, accept);
+        } else {
+            // Group 0 is the whole match.
+            int close = nfa_.add(nfa::save, accept, -1, 1);
+            int body = compile(root, close);
+            nfa_.start = nfa_.add(nfa::save, body, -1, 0);
+        }
+    }
+
+private:
+    // Compiles node 'n' so that it continues with state 'next'; returns its entry.
+    int compile(int n, int next) {
+        const ast_node& node = nodes_[n];
+        switch (node.kind) {
+        case ast_node::chars:
+            nfa_.sets.push_back(node.set);
+            return nfa_.add(nfa::consume, next, -1, static_cast<int>(nfa_.sets.size() - 1));
+        case ast_node::empty:
+            return next;
+        case ast_node::concat:
+            if (reversed_) {
+                for (size_t i = 0; i < node.children.size(); ++i) {
+                    next = compile(node.children[i], next);
+                }
+            } else {
+                for (size_t i = node.children.size(); i-- > 0; ) {
+                    next = compile(node.children[i], next);
+                }
+            }
+            return next;
+        case ast_node::alternate: {
+            int entry = compile(node.children.back(), next);
+            for (size_t i = node.children.size() - 1; i-- > 0; ) {
+                int branch = compile(node.children[i], next);
+                entry = nfa_.add(nfa::split, branch, entry);
+            }
+            return entry;
+        }
+        case ast_node::quest: {
+            int body = compile(node.children[0], next);
+            return node.greedy ? nfa_.add(nfa::split, body, next) : nfa_.add(nfa::split, next, body);
+        }
+        case ast_node::star: {
+            int loop = nfa_.add(nfa::split);
+            int body = compile(node.children[0], loop);
+            set_fork(loop, node.greedy, body, next);
+            return loop;
+        }
+        case ast_node::plus: {
+            int loop = nfa_.add(nfa::split);
+            int body = compile(node.children[0], loop);
+            set_fork(loop, node.greedy, body, next);
+            return body;
+        }
+        case ast_node::group: {
+            if (reversed_) {
+                return compile(node.children[0], next);
+            }
+            int close = nfa_.add(nfa::save, next, -1, 2 * node.group_index + 1);
+            int body = compile(node.children[0], close);
+            return nfa_.add(nfa::save, body, -1, 2 * node.group_index);
+        }
+        }
+        return next;
+    }
+
+    void set_fork(int split, bool greedy, int body, int next) {
+        nfa_.states[split].out = greedy ? body : next;
+        nfa_.states[split].out1 = greedy ? next : body;
+    }
+
+    const vector<ast_node>& nodes_;
+    const bool reversed_;
+    nfa& nfa_;
+};
+
+
+//////////////////////////////////////////////////
+// Bytes that no set in the NFA distinguishes are
+// merged into one equivalence class. For typical
+// patterns only a handful of classes remain, which
+// keeps DFA transition tables small.
+//
+struct byte_classes {
+    unsigned char class_of[256];
+    vector<unsigned char> representative;
+
+    explicit byte_classes(const vector<byte_set>& sets) {
+        map<vector<bool>, int> signatures;
+        for (int c = 0; c < 256; ++c) {
+            vector<bool> signature(sets.size());
+            for (size_t i = 0; i < sets.size(); ++i) {
+                signature[i] = sets[i][c];
+            }
+            auto it = signatures.find(signature);
+            if (it == signatures.end()) {
+                it = signatures.insert(make_pair(signature, static_cast<int>(representative.size()))).first;
+                representative.push_back(static_cast<unsigned char>(c));
+            }
+            class_of[c] = static_cast<unsigned char>(it->second);
+        }
+    }
+
+    size_t size() const { return representative.size(); }
+};
+
+
+//////////////////////////////////////////////////
+// Lazily built DFA. A DFA state is the list of
+// NFA states that are alive at a text position,
+// ordered by priority. In 'leftmost_first' mode
+// everything behind an accepting NFA state is cut
+// off, as a backtracking matcher would never get
+// there. In 'unanchored' mode the NFA start state
+// is appended after every step -- with the lowest
+// priority -- until the first match is seen.
+//
+class lazy_dfa {
+public:
+    static const int dead = 0;
+
+    lazy_dfa(const nfa& automaton, const byte_classes& classes, bool leftmost_first, bool unanchored)
+        : nfa_(automaton), classes_(classes),
+          leftmost_first_{leftmost_first}, unanchored_{unanchored},
+          marks_(automaton.states.size(), 0) {
+        reset();
+    }
+
+    int start() {
+        if (start_ < 0) {
+            vector<int> list;
+            ++generation_;
+            add_closure(nfa_.start, list);
+            start_ = intern(list, unanchored_ && !contains_match(list));
+        }
+        return start_;
+    }
+
+    bool is_match(int state) const { return matching_[state]; }
+
+    int next(int state, unsigned char c) {
+        int& cached = transitions_[state * classes_.size() + classes_.class_of[c]];
+        if (cached >= 0) {
+            return cached;
+        }
+        return compute_next(state, c);
+    }
+
+    size_t state_count() const { return lists_.size(); }
+
+private:
+    // Upper bound for cached states; the cache is flushed when it's reached.
+    static const size_t max_states = 10000;
+
+    void reset() {
+        lists_.clear();
+        seeding_.clear();
+        matching_.clear();
+        transitions_.clear();
+        index_.clear();
+        start_ = -1;
+        vector<int> none;
+        intern(none, false);   // State 0 is the dead state.
+    }
+
+    // Appends the states reachable from 's' without consuming input. Returns
+    // true if an accepting state was added and lower priorities are cut off.
+    bool add_closure(int s, vector<int>& list) {
+        if (marks_[s] == generation_) {
+            return false;
+        }
+        marks_[s] = generation_;
+        const nfa::state& st = nfa_.states[s];
+        switch (st.op) {
+        case nfa::split:
+            return add_closure(st.out, list) || add_closure(st.out1, list);
+        case nfa::save:
+            return add_closure(st.out, list);
+        case nfa::consume:
+            list.push_back(s);
+            return false;
+        case nfa::match:
+            list.push_back(s);
+            return leftmost_first_;
+        }
+        return false;
+    }
+
+    int compute_next(int state, unsigned char c) {
+        c = classes_.representative[classes_.class_of[c]];
+        vector<int> list;
+        ++generation_;
+        bool cut = false;
+        for (int s : lists_[state]) {
+            const nfa::state& st = nfa_.states[s];
+            if (st.op == nfa::consume && nfa_.sets[st.arg][c] && add_closure(st.out, list)) {
+                cut = true;
+                break;
+            }
+        }
+        bool seeding = seeding_[state];
+        if (seeding && !cut) {
+            add_closure(nfa_.start, list);
+        }
+        seeding = seeding && !contains_match(list);
+
+        size_t slot = state * classes_.size() + classes_.class_of[c];
+        if (lists_.size() >= max_states) {
+            // Start over; 'state' is no longer valid afterwards.
+            reset();
+            return intern(list, seeding);
+        }
+        int target = intern(list, seeding);
+        transitions_[slot] = target;
+        return target;
+    }
+
+    bool contains_match(const vector<int>& list) const {
+        for (int s : list) {
+            if (nfa_.states[s].op == nfa::match) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int intern(vector<int>& list, bool seeding) {
+        list.push_back(seeding ? -1 : -2);  // Seeding is part of the identity.
+        auto it = index_.find(list);
+        if (it != index_.end()) {
+            return it->second;
+        }
+        int id = static_cast<int>(lists_.size());
+        index_.insert(make_pair(list, id));
+        list.pop_back();
+        matching_.push_back(contains_match(list));
+        lists_.push_back(list);
+        seeding_.push_back(seeding);
+        transitions_.resize(transitions_.size() + classes_.size(), -1);
+        return id;
+    }
+
+    const nfa& nfa_;
+    const byte_classes& classes_;
+    const bool leftmost_first_;
+    const bool unanchored_;
+
+    vector<vector<int>> lists_;
+    vector<bool> seeding_;
+    vector<char> matching_;
+    vector<int> transitions_;
+    map<vector<int>, int> index_;
+    int start_ = -1;
+
+    vector<unsigned> marks_;
+    unsigned generation_ = 0;
+};
+
+
+//////////////////////////////////////////////////
+// Literal fast path. Many patterns are plain
+// strings ("quick") or start with one ("mailto:").
+// Every match of such a pattern starts with that
+// literal, so the text can be skimmed with a fast
+// substring search, and the DFA only needs to run
+// from the first candidate position on.
+//
+// The substring search compares the first and the
+// last byte of the needle against 16 (SSE2) or 32
+// (AVX2) text positions at once and verifies only
+// where both agree. For 'icase', ASCII letters are
+// folded to lower case in the vector registers.
+// AVX2 is chosen at run-time if the CPU has it.
+//
+class literal_finder {
+public:
+    literal_finder(const string& needle, bool icase) : needle_(needle), icase_{icase} {
+        assert(!needle_.empty());
+        if (icase_) {
+            for (char& c : needle_) {
+                c = fold(c);
+            }
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        use_avx2_ = __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    const string& needle() const { return needle_; }
+    bool icase() const { return icase_; }
+
+    // Returns the first occurrence in [first, last) or nullptr.
+    const char* find(const char* first, const char* last) const {
+        if (static_cast<size_t>(last - first) < needle_.size()) {
+            return nullptr;
+        }
+#if defined(__SSE2__)
+        if (use_avx2_) {
+            return find_avx2(first, last);
+        }
+        return find_sse2(first, last);
+#else
+        return find_scalar(first, last);
+#endif
+    }
+
+    // Scalar version, also used for the tail of the vectorized ones.
+    const char* find_scalar(const char* first, const char* last) const {
+        const size_t n = needle_.size();
+        for (const char* p = first; p + n <= last; ++p) {
+            if (fold_if(*p) == needle_[0] && verify(p)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+#if defined(__SSE2__)
+    const char* find_sse2(const char* first, const char* last) const {
+        const size_t n = needle_.size();
+        const __m128i head = _mm_set1_epi8(needle_[0]);
+        const __m128i tail = _mm_set1_epi8(needle_[n - 1]);
+        const char* p = first;
+        for (; p + n - 1 + 16 <= last; p += 16) {
+            __m128i a = load_folded(p);
+            __m128i b = load_folded(p + n - 1);
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail)));
+            while (mask != 0) {
+                const char* candidate = p + __builtin_ctz(mask);
+                if (verify(candidate)) {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return find_scalar(p, last);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_avx2(const char* first, const char* last) const {
+        const size_t n = needle_.size();
+        const __m256i head = _mm256_set1_epi8(needle_[0]);
+        const __m256i tail = _mm256_set1_epi8(needle_[n - 1]);
+        const char* p = first;
+        for (; p + n - 1 + 32 <= last; p += 32) {
+            __m256i a = load_folded_avx2(p);
+            __m256i b = load_folded_avx2(p + n - 1);
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, head), _mm256_cmpeq_epi8(b, tail))));
+            while (mask != 0) {
+                const char* candidate = p + __builtin_ctz(mask);
+                if (verify(candidate)) {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return find_sse2(p, last);
+    }
+#endif
+
+private:
+    static char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    char fold_if(char c) const { return icase_ ? fold(c) : c; }
+
+    bool verify(const char* p) const {
+        if (!icase_) {
+            return memcmp(p, needle_.data(), needle_.size()) == 0;
+        }
+        for (size_t i = 0; i < needle_.size(); ++i) {
+            if (fold(p[i]) != needle_[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#if defined(__SSE2__)
+    __m128i load_folded(const char* p) const {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (!icase_) {
+            return c;
+        }
+        // 'A'..'Z' become -128..-103 after the shift; everything else is larger.
+        __m128i shifted = _mm_add_epi8(c, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+        __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+        return _mm_or_si128(c, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    }
+
+    __attribute__((target("avx2")))
+    __m256i load_folded_avx2(const char* p) const {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (!icase_) {
+            return c;
+        }
+        __m256i shifted = _mm256_add_epi8(c, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + 26)), shifted);
+        return _mm256_or_si256(c, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    }
+#endif
+
+    string needle_;
+    const bool icase_;
+    bool use_avx2_ = false;
+};
+
+
+// Extracts the literal every match must start with. Each byte set of the
+// leading 'chars' nodes must be a single byte, or -- for 'icase' -- an ASCII
+// letter in both cases. 'whole' tells whether the literal is the entire
+// pattern.
+struct literal_prefix {
+    string text;
+    bool icase = false;
+    bool whole = false;
+};
+
+
+class literal_extractor {
+public:
+    explicit literal_extractor(const vector<ast_node>& nodes) : nodes_(nodes) { }
+
+    literal_prefix extract(int root) {
+        complete_ = true;
+        walk(root);
+        prefix_.whole = complete_;
+        if (prefix_.text.empty()) {
+            prefix_.whole = false;
+        }
+        return prefix_;
+    }
+
+private:
+    // Returns false as soon as something other than a literal shows up.
+    bool walk(int n) {
+        const ast_node& node = nodes_[n];
+        switch (node.kind) {
+        case ast_node::chars:
+            if (add(node.set)) {
+                return true;
+            }
+            break;
+        case ast_node::empty:
+            return true;
+        case ast_node::group:
+            return walk(node.children[0]);
+        case ast_node::concat:
+            for (int child : node.children) {
+                if (!walk(child)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            break;
+        }
+        complete_ = false;
+        return false;
+    }
+
+    bool add(const byte_set& set) {
+        char c;
+        bool pair;
+        if (set.count() == 1) {
+            c = first_byte(set);
+            pair = false;
+        } else if (set.count() == 2) {
+            c = first_byte(set);     // The upper case letter comes first.
+            if (!(c >= 'A' && c <= 'Z' && set[c + ('a' - 'A')])) {
+                return false;
+            }
+            c = static_cast<char>(c + ('a' - 'A'));
+            pair = true;
+        } else {
+            return false;
+        }
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        if (letter) {
+            // All letters have to agree on case sensitivity.
+            if (mode_ == unknown) {
+                mode_ = pair ? folded : exact;
+            } else if ((mode_ == folded) != pair) {
+                return false;
+            }
+        }
+        prefix_.text += c;
+        prefix_.icase = mode_ == folded;
+        return true;
+    }
+
+    static char first_byte(const byte_set& set) {
+        for (int c = 0; c < 256; ++c) {
+            if (set[c]) {
+                return static_cast<char>(c);
+            }
+        }
+        return 0;
+    }
+
+    const vector<ast_node>& nodes_;
+    literal_prefix prefix_;
+    bool complete_ = true;
+    enum { unknown, exact, folded } mode_ = unknown;
+};
+
+
+class pike_vm;
+
+
+//////////////////////////////////////////////////
+// The compiled regex. Matching runs up to three
+// lazy DFAs and, if captures are requested, an
+// NFA simulation ("Pike VM") over the match only:
+//
+// - If the pattern starts with a literal, 'search'
+//   first skips to its next occurrence; if the
+//   pattern is nothing but a literal, that's it.
+// - 'search' runs the unanchored forward DFA to
+//   find where the leftmost-first match ends, then
+//   the reversed DFA backwards from there to find
+//   where it starts.
+// - 'full_match' runs the anchored forward DFA.
+// - 'captures' replays the NFA over the match to
+//   find the subexpression boundaries. The Pike
+//   VM and its thread lists are kept for the next
+//   call, so once the DFA caches are warm, neither
+//   searching nor capturing allocates.
+//
+// The DFA caches are filled while matching, so a
+// 'regex' must not be used by several threads at
+// once; give each thread its own copy.
+//
+class regex {
+public:
+    explicit regex(const string& pattern, flag_type flags = regex_constants::ECMAScript) {
+        parser p{pattern, (flags & regex_constants::icase) != 0, nodes_};
+        int root = p.parse();
+        groups_ = p.group_count();
+        nfa_compiler{nodes_, false, forward_}.compile(root);
+        nfa_compiler{nodes_, true, reverse_}.compile(root);
+        classes_.reset(new byte_classes{forward_.sets});
+        literal_ = literal_extractor{nodes_}.extract(root);
+        build_dfas();
+    }
+
+    regex(const regex& other)
+        : nodes_(other.nodes_), groups_{other.groups_},
+          forward_(other.forward_), reverse_(other.reverse_),
+          classes_{new byte_classes{*other.classes_}},
+          literal_(other.literal_) {
+        build_dfas();
+    }
+
+    regex& operator=(const regex&) = delete;
+
+    unsigned mark_count() const { return static_cast<unsigned>(groups_); }
+
+    // The literal every match starts with; empty if there is none.
+    const literal_prefix& literal() const { return literal_; }
+
+    // Finds the leftmost-first match in [first, last).
+    bool search(const char* first, const char* last, const char*& match_first, const char*& match_last) const {
+        if (finder_) {
+            first = finder_->find(first, last);
+            if (first == nullptr) {
+                return false;
+            }
+            if (literal_.whole) {
+                match_first = first;
+                match_last = first + literal_.text.size();
+                return true;
+            }
+        }
+        const char* end = find_end(first, last, false);
+        if (end == nullptr) {
+            return false;
+        }
+        match_first = find_start(first, end);
+        match_last = end;
+        return true;
+    }
+
+    // Like 'search', but only answers whether there is a match at all.
+    bool contains(const char* first, const char* last) const {
+        if (finder_) {
+            first = finder_->find(first, last);
+            if (first == nullptr || literal_.whole) {
+                return first != nullptr;
+            }
+        }
+        return find_end(first, last, true) != nullptr;
+    }
+
+    bool full_match(const char* first, const char* last) const {
+        if (literal_.whole) {
+            return static_cast<size_t>(last - first) == literal_.text.size() && finder_->find(first, last) == first;
+        }
+        lazy_dfa& dfa = *anchored_;
+        int s = dfa.start();
+        for (const char* p = first; p != last && s != lazy_dfa::dead; ++p) {
+            s = dfa.next(s, static_cast<unsigned char>(*p));
+        }
+        return dfa.is_match(s);
+    }
+
+    // Fills 'slots' with 2 * (mark_count() + 1) capture positions of the
+    // highest priority path that matches exactly [first, last).
+    void captures(const char* first, const char* last, vector<const char*>& slots) const;
+
+    // End of the highest priority non-empty match that starts exactly at
+    // 'first'; nullptr if there is none.
+    const char* non_empty_match(const char* first, const char* last) const;
+
+private:
+    void build_dfas() {
+        if (!literal_.text.empty()) {
+            finder_.reset(new literal_finder{literal_.text, literal_.icase});
+        }
+        searcher_.reset(new lazy_dfa{forward_, *classes_, true, true});
+        anchored_.reset(new lazy_dfa{forward_, *classes_, false, false});
+        backward_.reset(new lazy_dfa{reverse_, *classes_, false, false});
+    }
+
+    const char* find_end(const char* first, const char* last, bool earliest) const {
+        lazy_dfa& dfa = *searcher_;
+        int s = dfa.start();
+        const char* end = nullptr;
+        for (const char* p = first; ; ++p) {
+            if (dfa.is_match(s)) {
+                end = p;
+                if (earliest) {
+                    break;
+                }
+            }
+            if (p == last) {
+                break;
+            }
+            s = dfa.next(s, static_cast<unsigned char>(*p));
+            if (s == lazy_dfa::dead) {
+                break;
+            }
+        }
+        return end;
+    }
+
+    // Longest backward match that ends at 'end' and doesn't cross 'first'.
+    const char* find_start(const char* first, const char* end) const {
+        lazy_dfa& dfa = *backward_;
+        int s = dfa.start();
+        const char* start = end;
+        for (const char* p = end; ; --p) {
+            if (dfa.is_match(s)) {
+                start = p;
+            }
+            if (p == first) {
+                break;
+            }
+            s = dfa.next(s, static_cast<unsigned char>(p[-1]));
+            if (s == lazy_dfa::dead) {
+                break;
+            }
+        }
+        return start;
+    }
+
+    vector<ast_node> nodes_;
+    int groups_ = 0;
+    nfa forward_;
+    nfa reverse_;
+    unique_ptr<byte_classes> classes_;
+    literal_prefix literal_;
+    unique_ptr<literal_finder> finder_;
+    unique_ptr<lazy_dfa> searcher_;
+    unique_ptr<lazy_dfa> anchored_;
+    unique_ptr<lazy_dfa> backward_;
+    mutable unique_ptr<pike_vm> vm_;    // Created by the first 'captures'.
+};
+
+
+// Pike VM: simulates all NFA threads in lock-step, in priority order, each
+// thread carrying its own capture positions.
+class pike_vm {
+public:
+    pike_vm(const nfa& automaton, size_t slot_count)
+        : nfa_(automaton), slot_count_{slot_count},
+          current_{automaton.states.size(), slot_count}, next_{automaton.states.size(), slot_count},
+          caps_(slot_count) {
+    }
+
+    void run(const char* first, const char* last, vector<const char*>& slots) {
+        vector<const char*>& caps = caps_;
+        caps.assign(slot_count_, nullptr);
+        current_.clear();
+        add_thread(current_, nfa_.start, caps, first);
+        for (const char* p = first; ; ++p) {
+            next_.clear();
+            for (int pc : current_.pcs) {
+                const nfa::state& st = nfa_.states[pc];
+                if (st.op == nfa::match) {
+                    if (p == last) {
+                        // Highest priority thread that ends exactly at 'last'.
+                        slots.assign(current_.caps_of(pc), current_.caps_of(pc) + slot_count_);
+                        return;
+                    }
+                } else if (p != last && nfa_.sets[st.arg][static_cast<unsigned char>(*p)]) {
+                    caps.assign(current_.caps_of(pc), current_.caps_of(pc) + slot_count_);
+                    add_thread(next_, st.out, caps, p + 1);
+                }
+            }
+            if (p == last) {
+                break;
+            }
+            swap(current_, next_);
+        }
+        slots.assign(slot_count_, nullptr);
+    }
+
+    // End of the highest priority non-empty match that starts at 'first', like
+    // 'match_not_null | match_continuous'; nullptr if there is none.
+    const char* non_empty_match(const char* first, const char* last) {
+        vector<const char*>& caps = caps_;
+        caps.assign(slot_count_, nullptr);
+        current_.clear();
+        add_thread(current_, nfa_.start, caps, first);
+        const char* end = nullptr;
+        for (const char* p = first; !current_.pcs.empty(); ++p) {
+            next_.clear();
+            for (int pc : current_.pcs) {
+                const nfa::state& st = nfa_.states[pc];
+                if (st.op == nfa::match) {
+                    if (p != first) {
+                        end = p;
+                        break;      // Lower priority threads lose.
+                    }
+                } else if (p != last && nfa_.sets[st.arg][static_cast<unsigned char>(*p)]) {
+                    caps.assign(current_.caps_of(pc), current_.caps_of(pc) + slot_count_);
+                    add_thread(next_, st.out, caps, p + 1);
+                }
+            }
+            if (p == last) {
+                break;
+            }
+            swap(current_, next_);
+        }
+        return end;
+    }
+
+private:
+    struct thread_list {
+        thread_list(size_t states, size_t slots)
+            : marks(states, 0), caps(states * slots), slot_count{slots} { }
+
+        void clear() {
+            pcs.clear();
+            ++generation;
+        }
+
+        const char** caps_of(int pc) { return &caps[pc * slot_count]; }
+
+        vector<int> pcs;
+        vector<unsigned> marks;
+        unsigned generation = 1;
+        vector<const char*> caps;
+        size_t slot_count;
+    };
+
+    void add_thread(thread_list& list, int pc, vector<const char*>& caps, const char* p) {
+        if (list.marks[pc] == list.generation) {
+            return;
+        }
+        list.marks[pc] = list.generation;
+        const nfa::state& st = nfa_.states[pc];
+        switch (st.op) {
+        case nfa::split:
+            add_thread(list, st.out, caps, p);
+            add_thread(list, st.out1, caps, p);
+            break;
+        case nfa::save: {
+            const char* saved = caps[st.arg];
+            caps[st.arg] = p;
+            add_thread(list, st.out, caps, p);
+            caps[st.arg] = saved;
+            break;
+        }
+        case nfa::consume:
+        case nfa::match:
+            list.pcs.push_back(pc);
+            copy(caps.begin(), caps.end(), list.caps_of(pc));
+            break;
+        }
+    }
+
+    const nfa& nfa_;
+    const size_t slot_count_;
+    thread_list current_;
+    thread_list next_;
+    vector<const char*> caps_;
+};
+
+
+void regex::captures(const char* first, const char* last, vector<const char*>& slots) const {
+    if (!vm_) {
+        vm_.reset(new pike_vm{forward_, 2 * (mark_count() + 1)});
+    }
+    vm_->run(first, last, slots);
+}
+
+
+const char* regex::non_empty_match(const char* first, const char* last) const {
+    if (!vm_) {
+        vm_.reset(new pike_vm{forward_, 2 * (mark_count() + 1)});
+    }
+    return vm_->non_empty_match(first, last);
+}
+
+
+//////////////////////////////////////////////////
+// Match results, modelled after 'std::cmatch'.
+// Subexpressions are handed out as 'csub_match'
+// objects, so they compare against strings just
+// like the standard ones do.
+//
+class match_results {
+public:
+    size_t size() const { return slots_.size() / 2; }
+    bool empty() const { return slots_.empty(); }
+
+    csub_match operator[](size_t i) const {
+        csub_match sub;
+        sub.matched = i < size() && slots_[2 * i] != nullptr;
+        sub.first = sub.matched ? slots_[2 * i] : text_end_;
+        sub.second = sub.matched ? slots_[2 * i + 1] : text_end_;
+        return sub;
+    }
+
+    string str(size_t i = 0) const { return (*this)[i].str(); }
+    size_t position(size_t i = 0) const { return static_cast<size_t>((*this)[i].first - text_begin_); }
+    size_t length(size_t i = 0) const { return static_cast<size_t>((*this)[i].length()); }
+
+private:
+    friend bool regex_search(const char*, const char*, match_results&, const regex&);
+    friend bool regex_match(const char*, const char*, match_results&, const regex&);
+
+    void fill(const char* begin, const char* end, const regex& re, const char* first, const char* last) {
+        text_begin_ = begin;
+        text_end_ = end;
+        re.captures(first, last, slots_);
+    }
+
+    vector<const char*> slots_;
+    const char* text_begin_ = nullptr;
+    const char* text_end_ = nullptr;
+};
+
+
+//////////////////////////////////////////////////
+// Free functions mirroring 'std::regex_search',
+// 'std::regex_match' and 'std::regex_replace'.
+//
+inline bool regex_search(const char* first, const char* last, const regex& re) {
+    return re.contains(first, last);
+}
+
+
+bool regex_search(const char* first, const char* last, match_results& m, const regex& re) {
+    const char* match_first;
+    const char* match_last;
+    if (!re.search(first, last, match_first, match_last)) {
+        return false;
+    }
+    m.fill(first, last, re, match_first, match_last);
+    return true;
+}
+
+
+inline bool regex_search(const string& text, const regex& re) {
+    return regex_search(text.data(), text.data() + text.size(), re);
+}
+
+
+inline bool regex_search(const string& text, match_results& m, const regex& re) {
+    return regex_search(text.data(), text.data() + text.size(), m, re);
+}
+
+
+inline bool regex_match(const char* first, const char* last, const regex& re) {
+    return re.full_match(first, last);
+}
+
+
+bool regex_match(const char* first, const char* last, match_results& m, const regex& re) {
+    if (!re.full_match(first, last)) {
+        return false;
+    }
+    m.fill(first, last, re, first, last);
+    return true;
+}
+
+
+inline bool regex_match(const string& text, const regex& re) {
+    return regex_match(text.data(), text.data() + text.size(), re);
+}
+
+
+inline bool regex_match(const string& text, match_results& m, const regex& re) {
+    return regex_match(text.data(), text.data() + text.size(), m, re);
+}
+
+
+// Appends 'fmt' to 'out', expanding '$&', '$n', '$`', '$'' and '$$'.
+void append_format(string& out, const string& fmt, const vector<const char*>& slots,
+                   const char* text_first, const char* text_last) {
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        char c = fmt[i];
+        if (c != '$' || i + 1 == fmt.size()) {
+            out += c;
+            continue;
+        }
+        char spec = fmt[++i];
+        size_t group;
+        if (spec == '$') {
+            out += '$';
+            continue;
+        } else if (spec == '&') {
+            group = 0;
+        } else if (spec == '`') {
+            out.append(text_first, slots[0]);
+            continue;
+        } else if (spec == '\'') {
+            out.append(slots[1], text_last);
+            continue;
+        } else if (isdigit(static_cast<unsigned char>(spec))) {
+            group = spec - '0';
+        } else {
+            out += '$';
+            out += spec;
+            continue;
+        }
+        if (2 * group + 1 < slots.size() && slots[2 * group] != nullptr) {
+            out.append(slots[2 * group], slots[2 * group + 1]);
+        }
+    }
+}
+
+
+// After an empty match, a non-empty match at the same position is tried
+// first, like 'match_not_null | match_continuous' in 'regex_iterator'; if there
+// is none, the search resumes one character later.
+string regex_replace(const string& text, const regex& re, const string& fmt) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    bool needs_groups = fmt.find('$') != string::npos;
+
+    string out;
+    out.reserve(text.size());
+    vector<const char*> slots(2);
+    auto append_match = [&](const char* match_first, const char* match_last) {
+        if (needs_groups) {
+            re.captures(match_first, match_last, slots);
+        } else {
+            slots[0] = match_first;
+            slots[1] = match_last;
+        }
+        append_format(out, fmt, slots, first, last);
+    };
+
+    const char* p = first;
+    const char* match_first;
+    const char* match_last;
+    while (p <= last && re.search(p, last, match_first, match_last)) {
+        out.append(p, match_first);
+        append_match(match_first, match_last);
+        p = match_last;
+        if (match_first == match_last) {
+            if (const char* end = re.non_empty_match(p, last)) {
+                append_match(p, end);
+                p = end;
+                continue;
+            }
+            if (p == last) {
+                return out;
+            }
+            out += *p++;
+        }
+    }
+    out.append(p, last);
+    return out;
+}
+
+} // namespace dfa
+
+
+// Chapters that only want 'dfa::regex' define
+// DFA_REGEX_LIBRARY and include this file.
+#if !defined(DFA_REGEX_LIBRARY)
+
+//////////////////////////////////////////////////
+// Tests: the examples of the 'regex' chapter,
+// then a comparison with 'std::regex'.
+//
+void test_dfa_regex_essential() {
+    const string text("the quick brown fox jumps over the lazy dog");
+
+    const dfa::regex re("quick");
+    assert(dfa::regex_search(text, re));
+    assert(not dfa::regex_search(text, dfa::regex("bamboozled")));
+    assert(dfa::regex_match(text, dfa::regex("the quick brown.*dog")));
+
+    string replaced = dfa::regex_replace(text, dfa::regex("dog"), "cat");
+    assert(replaced == "the quick brown fox jumps over the lazy cat");
+
+    assert(not dfa::regex_search(text, dfa::regex("QUICK")));
+    assert(dfa::regex_search(text, dfa::regex("QUICK", regex_constants::icase)));
+}
+
+
+void test_dfa_regex_subexpression() {
+    const string text("mailto:ralf.holly@approxion.com");
+
+    const dfa::regex re{R"(mailto:(\S+)@(\S+))"};
+    dfa::match_results match_results;
+    assert(dfa::regex_search(text, match_results, re));
+    assert(match_results.size() == 1 + 2);
+    assert(match_results[0] == text);
+    assert(match_results[1] == "ralf.holly");
+    assert(match_results[2] == "approxion.com");
+}
+
+
+void test_dfa_regex_search_all() {
+    const string text("aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap");
+    const dfa::regex number_re{R"(\d+)"};
+
+    vector<string> numbers;
+    const char* p = text.data();
+    const char* last = p + text.size();
+    const char* first;
+    const char* end;
+    while (number_re.search(p, last, first, end)) {
+        numbers.push_back(string(first, end));
+        p = end;
+    }
+    assert((numbers == vector<string>{"1", "22", "333", "4444", "55555"}));
+
+    assert(dfa::regex_replace(text, number_re, "<$&>") == "aaa <1> bbb <22> dddae <333> foo <4444> bar<55555> zap");
+}
+
+
+void test_dfa_regex_errors() {
+    const char* unsupported[] = { "(abc", "abc)", "[abc", "*a", R"(\1)", "^abc", "a{2}" };
+    for (const char* pattern : unsupported) {
+        try {
+            dfa::regex re{pattern};
+            assert(false);
+        } catch (const regex_error&) {
+        }
+    }
+}
+
+
+// Checks search, match, captures and replace against 'std::regex'.
+void test_dfa_regex_vs_std_regex() {
+    const char* patterns[] = {
+        "quick", "dog", R"(\d+)", R"(\S+)", R"(mailto:(\S+)@(\S+))", "the quick brown.*dog",
+        "a|ab", "(a|ab)(c|bcd)(d*)", "(ab|a)*b", "a*", "a*?b", "(a+)(a+)", "(a+?)(a+)",
+        "x*", "[a-c]+", "[^ ]+ [^ ]+", R"((\w+)\s(\w+))", "(?:ab)+c", R"(\.)", "colou?r",
+        "(foo|foobar)(bar)?", ".*", "b.*?a", "x*|b", "x*|bc", "a?|ab", "(x*)(b|c)?",
+    };
+    const char* texts[] = {
+        "the quick brown fox jumps over the lazy dog",
+        "aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap",
+        "mailto:ralf.holly@approxion.com",
+        "abcd", "ab", "aaab", "aaaa", "", "xyz abc cab", "foobar", "color colour", "a.b",
+        "banana bandana", "b", "bc", "abcab",
+    };
+    for (const char* pattern : patterns) {
+        const std::regex std_re{pattern};
+        const dfa::regex dfa_re{pattern};
+        for (const char* text_ptr : texts) {
+            const string text(text_ptr);
+
+            smatch expected;
+            dfa::match_results actual;
+            bool found = regex_search(text, expected, std_re);
+            assert(dfa::regex_search(text, actual, dfa_re) == found);
+            assert(dfa::regex_search(text, dfa_re) == found);
+            if (found) {
+                assert(actual.size() == expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    assert(actual[i].matched == expected[i].matched);
+                    if (expected[i].matched) {
+                        assert(actual.position(i) == size_t(expected.position(i)));
+                        assert(actual.str(i) == expected.str(i));
+                    }
+                }
+            }
+
+            assert(dfa::regex_match(text, dfa_re) == regex_match(text, std_re));
+            assert(dfa::regex_replace(text, dfa_re, "[$&]") == regex_replace(text, std_re, "[$&]"));
+        }
+    }
+
+    // Case-insensitive.
+    const std::regex std_icase{"QUICK|LAZY d[o]G", regex_constants::icase};
+    const dfa::regex dfa_icase{"QUICK|LAZY d[o]G", regex_constants::icase};
+    const string text("the Quick brown fox jumps over the lazy DOG");
+    assert(dfa::regex_replace(text, dfa_icase, "X") == regex_replace(text, std_icase, "X"));
+
+    // Case is folded before a class is negated.
+    const char* icase_patterns[] = { "[^a]", "[^x]", "[^a-z]+", R"([^\W])", R"(\S+)", "[^A-Z0-9]" };
+    const char* icase_texts[] = { "a", "X", "ABC", "abc", "42", "a1B", "x y" };
+    for (const char* pattern : icase_patterns) {
+        const std::regex std_re{pattern, regex_constants::icase};
+        const dfa::regex dfa_re{pattern, regex_constants::icase};
+        for (const char* text_ptr : icase_texts) {
+            const string t(text_ptr);
+            assert(dfa::regex_search(t, dfa_re) == regex_search(t, std_re));
+            assert(dfa::regex_replace(t, dfa_re, "[$&]") == regex_replace(t, std_re, "[$&]"));
+        }
+    }
+    assert(!dfa::regex_search(string("a"), dfa::regex{"[^a]", regex_constants::icase}));
+    assert(!dfa::regex_search(string("X"), dfa::regex{"[^x]", regex_constants::icase}));
+    assert(!dfa::regex_search(string("ABC"), dfa::regex{"[^a-z]+", regex_constants::icase}));
+
+    // After an empty match, a non-empty one at the same position comes first.
+    assert(dfa::regex_replace("b", dfa::regex{"x*|b"}, "[$&]") == "[][b][]");
+    assert(dfa::regex_replace("abc", dfa::regex{"x*|bc"}, "[$&]") == "[]a[][bc][]");
+}
+
+
+// Patterns that make a backtracking matcher sweat are no problem.
+void test_dfa_regex_pathological() {
+    const dfa::regex re{"(a|aa)*c"};
+    const string text(5000, 'a');
+    assert(not dfa::regex_search(text, re));
+    assert(dfa::regex_search(text + "c", re));
+}
+
+
+void test_literal_detection() {
+    assert(dfa::regex("quick").literal().text == "quick");
+    assert(dfa::regex("quick").literal().whole);
+    assert(dfa::regex("QUICK", regex_constants::icase).literal().icase);
+    assert(dfa::regex("QUICK", regex_constants::icase).literal().text == "quick");
+
+    const dfa::regex mailto{R"(mailto:(\S+)@(\S+))"};
+    assert(mailto.literal().text == "mailto:");
+    assert(not mailto.literal().whole);
+
+    assert(dfa::regex("the quick brown.*dog").literal().text == "the quick brown");
+    assert(dfa::regex(R"(\d+)").literal().text.empty());
+    assert(dfa::regex("a|b").literal().text.empty());
+
+    // Mixed case sensitivity: the literal stops where it would become wrong.
+    assert(dfa::regex("ab[cC]d").literal().text == "ab");
+    const string text("xx abCd abcd");
+    const dfa::regex mixed{"ab[cC]d"};
+    dfa::match_results m;
+    assert(dfa::regex_search(text, m, mixed) && m.position() == 3);
+}
+
+
+void test_literal_finder() {
+    // Put needles at every offset and alignment around the vector widths.
+    const char* needles[] = { "q", "qu", "quick", "bamboozled", "abcdefghijklmnopqrstuvwxyz0123456789-=" };
+    for (const char* needle_ptr : needles) {
+        for (bool icase : { false, true }) {
+            // For 'icase', the finder gets upper case and the text mixed case.
+            string needle(needle_ptr), in_text(needle_ptr);
+            if (icase) {
+                for (size_t i = 0; i < needle.size(); ++i) {
+                    needle[i] = static_cast<char>(toupper(needle[i]));
+                    in_text[i] = i % 2 ? needle[i] : in_text[i];
+                }
+            }
+            dfa::literal_finder finder{needle, icase};
+            for (size_t size = needle.size(); size < 100; ++size) {
+                for (size_t pos = 0; pos + needle.size() <= size; ++pos) {
+                    string hay(size, '.');
+                    hay.replace(pos, in_text.size(), in_text);
+                    // A near miss in front must not fool the last-byte filter.
+                    if (pos >= needle.size()) {
+                        hay.replace(0, needle.size() - 1, in_text.substr(0, needle.size() - 1));
+                    }
+                    const char* first = hay.data();
+                    const char* last = first + hay.size();
+                    assert(finder.find(first, last) == first + pos);
+                    assert(finder.find_scalar(first, last) == first + pos);
+#if defined(__SSE2__)
+                    assert(finder.find_sse2(first, last) == first + pos);
+#endif
+                    assert(finder.find(first + pos + 1, last) == nullptr);
+                }
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: 'std::regex' vs. 'dfa::regex' on the
+// chapter's texts and on generated corpora.
+// Run with 'make bench'; pass the corpus size in
+// MiB as second argument (default 16).
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+static string make_corpus(size_t bytes) {
+    static const char* const lines[] = {
+        "the quick brown fox jumps over the lazy dog",
+        "aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap",
+        "contact: mailto:ralf.holly@approxion.com for details",
+        "nothing to see here, move along",
+    };
+    string text;
+    unsigned seed = 7;
+    while (text.size() < bytes) {
+        seed = seed * 1103515245 + 12345;
+        text += lines[(seed >> 16) % 4];
+        text += '\n';
+    }
+    return text;
+}
+
+
+void bench_dfa_regex(size_t mib) {
+    const string fox("the quick brown fox jumps over the lazy dog");
+    const size_t rounds = 100000;
+    cout << fixed << setprecision(3);
+
+    cout << "short text (test_regex_essential), us per operation" << endl;
+    cout << setw(26) << "pattern" << setw(12) << "std::regex" << setw(12) << "dfa::regex" << endl;
+    const char* short_patterns[] = { "quick", "bamboozled", "dog", R"(\d+)" };
+    for (const char* pattern : short_patterns) {
+        const std::regex std_re{pattern};
+        const dfa::regex dfa_re{pattern};
+        size_t hits = 0;
+        double s = seconds([&] { for (size_t i = 0; i < rounds; ++i) hits += regex_search(fox, std_re); });
+        double d = seconds([&] { for (size_t i = 0; i < rounds; ++i) hits += dfa::regex_search(fox, dfa_re); });
+        cout << setw(26) << pattern << setw(12) << s * 1e6 / rounds << setw(12) << d * 1e6 / rounds << endl;
+    }
+
+    const string corpus = make_corpus(mib * 1024 * 1024);
+    const double mb = corpus.size() / 1e6;
+    cout << endl << mib << " MiB corpus, MB/s (all matches)" << endl;
+    cout << setw(26) << "pattern" << setw(12) << "std::regex" << setw(12) << "dfa::regex" << endl;
+    const char* corpus_patterns[] = { "bamboozled", "lazy dog", R"(\d+)", R"(mailto:(\S+)@(\S+))", "QUICK" };
+    for (const char* pattern : corpus_patterns) {
+        auto flags = strcmp(pattern, "QUICK") == 0 ? regex_constants::icase : regex_constants::ECMAScript;
+        const std::regex std_re{pattern, flags};
+        const dfa::regex dfa_re{pattern, flags};
+        size_t n1 = 0, n2 = 0;
+        double s = seconds([&] {
+            for (cregex_iterator it(corpus.data(), corpus.data() + corpus.size(), std_re); it != cregex_iterator(); ++it) ++n1;
+        });
+        double d = seconds([&] {
+            const char* p = corpus.data();
+            const char* last = p + corpus.size();
+            const char* first;
+            const char* end;
+            while (dfa_re.search(p, last, first, end)) {
+                ++n2;
+                p = end == first ? end + 1 : end;
+            }
+        });
+        assert(n1 == n2);
+        cout << setw(26) << pattern << setw(12) << mb / s << setw(12) << mb / d << endl;
+    }
+
+    cout << endl << "pathological (a|aa)*c on a^n, ms" << endl;
+    cout << setw(26) << "n" << setw(12) << "std::regex" << setw(12) << "dfa::regex" << endl;
+    for (size_t n = 16; n <= 28; n += 4) {
+        const string text(n, 'a');
+        const std::regex std_re{"(a|aa)*c"};
+        const dfa::regex dfa_re{"(a|aa)*c"};
+        double s = seconds([&] { regex_search(text, std_re); });
+        double d = seconds([&] { dfa::regex_search(text, dfa_re); });
+        cout << setw(26) << n << setw(12) << s * 1e3 << setw(12) << d * 1e3 << endl;
+    }
+}
+
+
+void bench_literal_search(size_t mib) {
+    // Corpus without the needle, needle at the very end.
+    string corpus = make_corpus(mib * 1024 * 1024);
+    corpus += "bamboozled";
+    const char* first = corpus.data();
+    const char* last = first + corpus.size();
+    const double gb = corpus.size() / 1e9;
+    const char* expected = last - 10;
+
+    dfa::literal_finder exact{"bamboozled", false};
+    dfa::literal_finder folded{"BAMBOOZLED", true};
+    const std::regex std_re{"bamboozled"};
+    const std::regex std_icase{"BAMBOOZLED", regex_constants::icase};
+    const dfa::regex dfa_re{"bamboozled"};
+    const dfa::regex dfa_icase{"BAMBOOZLED", regex_constants::icase};
+
+    cout << endl << "literal search, " << mib << " MiB, GB/s" << endl;
+    cout << fixed << setprecision(2);
+    auto row = [&](const char* name, double s) { cout << setw(26) << name << setw(12) << gb / s << endl; };
+    row("string::find", seconds([&] { assert(corpus.find("bamboozled") == corpus.size() - 10); }));
+    row("std::regex", seconds([&] { assert(regex_search(corpus, std_re)); }));
+    row("std::regex icase", seconds([&] { assert(regex_search(corpus, std_icase)); }));
+    row("dfa::regex", seconds([&] { assert(dfa::regex_search(corpus, dfa_re)); }));
+    row("dfa::regex icase", seconds([&] { assert(dfa::regex_search(corpus, dfa_icase)); }));
+    row("finder scalar", seconds([&] { assert(exact.find_scalar(first, last) == expected); }));
+#if defined(__SSE2__)
+    row("finder sse2", seconds([&] { assert(exact.find_sse2(first, last) == expected); }));
+    row("finder sse2 icase", seconds([&] { assert(folded.find_sse2(first, last) == expected); }));
+    if (__builtin_cpu_supports("avx2")) {
+        row("finder avx2", seconds([&] { assert(exact.find_avx2(first, last) == expected); }));
+        row("finder avx2 icase", seconds([&] { assert(folded.find_avx2(first, last) == expected); }));
+    }
+#endif
+}
+
+
+int main(int argc, char* argv[]) {
+    test_dfa_regex_essential();
+    test_dfa_regex_subexpression();
+    test_dfa_regex_search_all();
+    test_dfa_regex_errors();
+    test_dfa_regex_vs_std_regex();
+    test_dfa_regex_pathological();
+    test_literal_detection();
+    test_literal_finder();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 16;
+        bench_dfa_regex(mib);
+        bench_literal_search(mib);
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,331 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+
+#include <limits>
+#include <memory>
+#include <new>
+#include <chrono>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'unique_ptr<T[]>' calls 'delete[]' by default,
+// which is fine for memory obtained from 'new[]'.
+// For large arrays, 'new[]' is not the best choice:
+// it guarantees only 16-byte alignment and uses
+// regular 4 KiB pages, so that a multi-GB array
+// needs hundreds of thousands of TLB entries.
+//
+// 'make_array' allocates trivial arrays with a
+// given placement policy and returns them as
+// 'unique_ptr<T[], array_deleter<T>>'. The deleter
+// remembers how the memory was obtained.
+//
+enum class placement {
+    cache_line,     // posix_memalign(), 64-byte alignment.
+    page,           // posix_memalign(), page alignment.
+    huge_page,      // mmap() + MADV_HUGEPAGE, 2 MiB alignment.
+};
+
+
+static const size_t cache_line_size = 64;
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+
+template<typename T>
+class array_deleter {
+public:
+    array_deleter() = default;
+    array_deleter(placement where, size_t mapped_bytes) : where_{where}, mapped_bytes_{mapped_bytes} { }
+
+    void operator()(T* p) const {
+        if (where_ == placement::huge_page) {
+            munmap(p, mapped_bytes_);
+        } else {
+            free(p);
+        }
+    }
+
+    placement where() const { return where_; }
+
+private:
+    placement where_ = placement::cache_line;
+    size_t mapped_bytes_ = 0;
+};
+
+
+template<typename T>
+using array_ptr = unique_ptr<T[], array_deleter<T>>;
+
+
+// Maps 'bytes' of anonymous memory on a huge page boundary and asks the
+// kernel to back it with transparent huge pages.
+static void* map_huge(size_t bytes) {
+    // Over-map by one huge page, then trim both ends to get alignment.
+    size_t span = bytes + huge_page_size;
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw bad_alloc{};
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = round_up(start, huge_page_size);
+    if (aligned != start) {
+        munmap(raw, aligned - start);
+    }
+    size_t tail = (start + span) - (aligned + bytes);
+    if (tail != 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    void* p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    // Only a hint; if THP is disabled we still get (aligned) regular pages.
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+
+// Returns a zero-initialized array of 'count' elements.
+template<typename T>
+array_ptr<T> make_array(size_t count, placement where) {
+    static_assert(is_trivial<T>::value, "make_array only supports trivial types");
+    // Leaves room for rounding up and for the extra huge page 'map_huge' maps.
+    if (count > (numeric_limits<size_t>::max() - 2 * huge_page_size) / sizeof(T)) {
+        throw bad_alloc{};
+    }
+    size_t bytes = count * sizeof(T);
+
+    if (where == placement::huge_page) {
+        size_t mapped = round_up(max(bytes, size_t{1}), huge_page_size);
+        // Anonymous mappings are zero-filled by the kernel.
+        return array_ptr<T>{static_cast<T*>(map_huge(mapped)), array_deleter<T>{where, mapped}};
+    }
+
+    size_t align = where == placement::page ? size_t(sysconf(_SC_PAGESIZE)) : cache_line_size;
+    void* p = nullptr;
+    if (posix_memalign(&p, max(align, alignof(T)), round_up(max(bytes, size_t{1}), align)) != 0) {
+        throw bad_alloc{};
+    }
+    memset(p, 0, bytes);
+    return array_ptr<T>{static_cast<T*>(p), array_deleter<T>{where, 0}};
+}
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_cache_line_array() {
+    array_ptr<int> a = make_array<int>(100, placement::cache_line);
+    assert(reinterpret_cast<uintptr_t>(a.get()) % cache_line_size == 0);
+    assert(a[0] == 0 && a[99] == 0);
+    a[1] = 22;
+    assert(a[1] == 22);
+}
+
+
+void test_page_array() {
+    array_ptr<double> a = make_array<double>(1000, placement::page);
+    assert(reinterpret_cast<uintptr_t>(a.get()) % sysconf(_SC_PAGESIZE) == 0);
+    a[999] = 3.14;
+    assert(a[999] == 3.14);
+}
+
+
+void test_huge_page_array() {
+    const size_t count = 3 * huge_page_size / sizeof(uint64_t) + 5;
+    array_ptr<uint64_t> a = make_array<uint64_t>(count, placement::huge_page);
+    assert(reinterpret_cast<uintptr_t>(a.get()) % huge_page_size == 0);
+    assert(a.get_deleter().where() == placement::huge_page);
+    for (size_t i = 0; i < count; ++i) {
+        a[i] = i;
+    }
+    assert(a[count - 1] == count - 1);
+
+    // Like any unique_ptr, ownership can be moved; the deleter goes along.
+    array_ptr<uint64_t> b = std::move(a);
+    assert(!a);
+    assert(b[42] == 42);
+}
+
+
+void test_array_size_overflow() {
+    // 'count * sizeof(T)' would wrap around to a small size.
+    const size_t max_count = numeric_limits<size_t>::max() / sizeof(uint64_t);
+    const size_t too_many[] = { max_count + 2, max_count };
+    for (size_t count : too_many) {
+        for (placement where : { placement::cache_line, placement::page, placement::huge_page }) {
+            try {
+                make_array<uint64_t>(count, where);
+                assert(false);
+            } catch (const bad_alloc&) {
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: random access and streaming over a
+// large array, 'new[]' vs. the placement policies.
+// Run with 'make bench'; the array size in MiB can
+// be passed as second argument.
+//
+// Where permitted, dTLB misses are read through
+// perf_event_open(); otherwise 'n/a' is printed.
+//
+class dtlb_counter {
+public:
+    dtlb_counter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~dtlb_counter() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    void start() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    // Returns -1 if counting is not available.
+    long long stop() {
+        long long count = -1;
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+
+// Returns AnonHugePages of this process in KiB, as reported by the kernel.
+static long anon_huge_kib() {
+    ifstream smaps{"/proc/self/smaps_rollup"};
+    string key;
+    long value = 0;
+    while (smaps >> key) {
+        if (key == "AnonHugePages:") {
+            smaps >> value;
+            return value;
+        }
+        smaps.ignore(256, '\n');
+    }
+    return -1;
+}
+
+
+static void print_row(const char* name, double random_ns, long long random_misses,
+                      double stream_gbs, long huge_kib) {
+    cout << setw(12) << name << fixed << setprecision(2) << setw(12) << random_ns;
+    if (random_misses >= 0) cout << setw(14) << random_misses; else cout << setw(14) << "n/a";
+    cout << setw(12) << stream_gbs << setw(14) << huge_kib / 1024 << endl;
+}
+
+
+template<typename Array>
+static void run_array_bench(const char* name, Array& a, size_t count) {
+    using clock = chrono::steady_clock;
+    for (size_t i = 0; i < count; ++i) {
+        a[i] = i;   // Fault everything in before measuring.
+    }
+    long huge_kib = anon_huge_kib();
+
+    // Random access: dependent loads, so latency (and TLB walks) dominate.
+    const size_t accesses = 20000000;
+    dtlb_counter dtlb;
+    uint64_t x = 12345, sum = 0;
+    dtlb.start();
+    auto start = clock::now();
+    for (size_t i = 0; i < accesses; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL + sum;
+        sum += a[(x >> 17) % count] & 1;
+    }
+    chrono::duration<double, nano> random = clock::now() - start;
+    long long misses = dtlb.stop();
+
+    // Streaming: sequential sum, bandwidth-bound.
+    start = clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        sum += a[i];
+    }
+    chrono::duration<double> stream = clock::now() - start;
+
+    volatile uint64_t sink = sum;
+    (void)sink;
+    print_row(name, random.count() / accesses, misses,
+              count * sizeof(uint64_t) / stream.count() / 1e9, huge_kib);
+}
+
+
+void bench_huge_arrays(size_t mib) {
+    const size_t count = mib * 1024 * 1024 / sizeof(uint64_t);
+    cout << mib << " MiB array of uint64_t" << endl;
+    cout << setw(12) << "allocation" << setw(12) << "random ns" << setw(14) << "dTLB misses"
+         << setw(12) << "stream GB/s" << setw(14) << "THP MiB" << endl;
+    {
+    unique_ptr<uint64_t[]> a{new uint64_t[count]};
+    run_array_bench("new[]", a, count);
+    }
+    {
+    array_ptr<uint64_t> a = make_array<uint64_t>(count, placement::cache_line);
+    run_array_bench("cache_line", a, count);
+    }
+    {
+    array_ptr<uint64_t> a = make_array<uint64_t>(count, placement::page);
+    run_array_bench("page", a, count);
+    }
+    {
+    array_ptr<uint64_t> a = make_array<uint64_t>(count, placement::huge_page);
+    run_array_bench("huge_page", a, count);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_cache_line_array();
+    test_page_array();
+    test_huge_page_array();
+    test_array_size_overflow();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_huge_arrays(argc > 2 ? strtoul(argv[2], nullptr, 10) : 512);
+    }
+
+    return 0;
+}
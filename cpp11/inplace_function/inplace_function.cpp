@@ -0,0 +1,432 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Lambdas can be stored in 'auto' variables, but
+// each has its own type. To put them in a container
+// or pass them through a non-template API, they
+// are usually wrapped in 'std::function', which
+// moves captures that don't fit its small internal
+// buffer (16 bytes in libstdc++) to the heap.
+//
+// 'inplace_function<R(Args...), Capacity>' stores
+// the callable inside itself, always. A callable
+// that doesn't fit is a compile error, not a heap
+// allocation. Calls, copies and destruction go
+// through a small static table of function
+// pointers per callable type. The callable must
+// be nothrow movable, so that moving the wrapper
+// -- e. g. when a 'vector' grows -- can't throw.
+// Like with 'std::function', a null function
+// pointer or an empty 'std::function' makes an
+// empty 'inplace_function'.
+//
+// 'function_ref<R(Args...)>' doesn't store the
+// callable at all: it's a pointer to it plus a
+// pointer to a call thunk, for parameters that
+// are only called during the function call. The
+// callable must outlive the 'function_ref'.
+//
+template<typename Signature, size_t Capacity = 32, size_t Align = alignof(max_align_t)>
+class inplace_function;
+
+
+template<typename R, typename... Args, size_t Capacity, size_t Align>
+class inplace_function<R(Args...), Capacity, Align> {
+public:
+    inplace_function() noexcept : ops_{empty_ops()} { }
+    inplace_function(nullptr_t) noexcept : ops_{empty_ops()} { }
+
+    template<typename F, typename = typename enable_if<
+        !is_same<typename decay<F>::type, inplace_function>::value>::type>
+    inplace_function(F&& f) : ops_{empty_ops()} {
+        using callable = typename decay<F>::type;
+        static_assert(sizeof(callable) <= Capacity, "callable doesn't fit; increase the capacity");
+        static_assert(Align % alignof(callable) == 0, "callable needs a larger alignment");
+        static_assert(is_nothrow_move_constructible<callable>::value, "callable must be nothrow movable");
+        if (!is_null(f)) {
+            ::new (&storage_) callable(std::forward<F>(f));
+            ops_ = callable_ops<callable>();
+        }
+    }
+
+    inplace_function(const inplace_function& other) : ops_{other.ops_} {
+        ops_->copy(&storage_, &other.storage_);
+    }
+
+    inplace_function(inplace_function&& other) noexcept : ops_{other.ops_} {
+        ops_->move(&storage_, &other.storage_);
+    }
+
+    ~inplace_function() {
+        ops_->destroy(&storage_);
+    }
+
+    inplace_function& operator=(inplace_function other) {
+        // 'other' is a copy or was moved to; destroy ours and move it in.
+        ops_->destroy(&storage_);
+        ops_ = empty_ops();
+        other.ops_->move(&storage_, &other.storage_);
+        ops_ = other.ops_;
+        return *this;
+    }
+
+    // Like 'std::function', throws 'bad_function_call' if empty.
+    R operator()(Args... args) const {
+        return ops_->invoke(const_cast<void*>(static_cast<const void*>(&storage_)), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != empty_ops(); }
+
+private:
+    template<typename F>
+    static bool is_null(const F&) { return false; }
+
+    template<typename F>
+    static bool is_null(F* f) { return f == nullptr; }
+
+    template<typename Signature>
+    static bool is_null(const function<Signature>& f) { return !f; }
+
+    struct ops {
+        R (*invoke)(void*, Args&&...);
+        void (*copy)(void* dst, const void* src);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template<typename F>
+    struct callable_impl {
+        static R invoke(void* f, Args&&... args) { return (*static_cast<F*>(f))(std::forward<Args>(args)...); }
+        static void copy(void* dst, const void* src) { ::new (dst) F(*static_cast<const F*>(src)); }
+        static void move(void* dst, void* src) noexcept { ::new (dst) F(std::move(*static_cast<F*>(src))); }
+        static void destroy(void* f) { static_cast<F*>(f)->~F(); }
+    };
+
+    struct empty_impl {
+        static R invoke(void*, Args&&...) { throw bad_function_call{}; }
+        static void copy(void*, const void*) { }
+        static void move(void*, void*) noexcept { }
+        static void destroy(void*) { }
+    };
+
+    // Constant-initialized; one table per callable type.
+    template<typename F>
+    static const ops* callable_ops() {
+        static const ops table = { &callable_impl<F>::invoke, &callable_impl<F>::copy,
+                                   &callable_impl<F>::move, &callable_impl<F>::destroy };
+        return &table;
+    }
+
+    static const ops* empty_ops() {
+        static const ops table = { &empty_impl::invoke, &empty_impl::copy, &empty_impl::move, &empty_impl::destroy };
+        return &table;
+    }
+
+    typename aligned_storage<Capacity, Align>::type storage_;
+    const ops* ops_;
+};
+
+
+template<typename Signature>
+class function_ref;
+
+
+template<typename R, typename... Args>
+class function_ref<R(Args...)> {
+public:
+    template<typename F, typename = typename enable_if<
+        !is_same<typename decay<F>::type, function_ref>::value &&
+        !is_function<typename remove_reference<F>::type>::value>::type>
+    function_ref(F&& f) noexcept : thunk_{&call_object<typename remove_reference<F>::type>} {
+        callable_.object = const_cast<void*>(static_cast<const void*>(addressof(f)));
+    }
+
+    // Function pointers can't be stored as 'void*' portably.
+    function_ref(R (*f)(Args...)) noexcept : thunk_{&call_function} {
+        callable_.function = f;
+    }
+
+    R operator()(Args... args) const {
+        return thunk_(callable_, std::forward<Args>(args)...);
+    }
+
+private:
+    union callable {
+        void* object;
+        R (*function)(Args...);
+    };
+
+    template<typename F>
+    static R call_object(callable c, Args&&... args) {
+        return (*static_cast<F*>(c.object))(std::forward<Args>(args)...);
+    }
+
+    static R call_function(callable c, Args&&... args) {
+        return c.function(std::forward<Args>(args)...);
+    }
+
+    callable callable_;
+    R (*thunk_)(callable, Args&&...);
+};
+
+
+//////////////////////////////////////////////////
+// Counts heap allocations, for the tests and the
+// benchmark.
+//
+static size_t allocation_count = 0;
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+static int triple(int x) { return 3 * x; }
+
+
+void test_inplace_function_captures() {
+    int answer = 42;
+    inplace_function<int()> by_value = [answer]() { return answer; };
+    inplace_function<void()> by_reference = [&]() { ++answer; };
+    inplace_function<int(int, int)> my_sum = [](int a, int b) -> int { return a + b; };
+
+    assert(by_value() == 42);
+    by_reference();
+    assert(answer == 43);
+    assert(by_value() == 42);
+    assert(my_sum(1, 2) == 3);
+
+    // Stored in a container, called through a common type.
+    vector<inplace_function<int(int)>> ops;
+    ops.push_back([](int x) { return x + 1; });
+    ops.push_back([answer](int x) { return x * answer; });
+    assert(ops[0](1) == 2 && ops[1](2) == 86);
+
+    // Mutable lambdas keep their state.
+    inplace_function<int()> counter = [answer]() mutable { return ++answer; };
+    assert(counter() == 44 && counter() == 45);
+}
+
+
+void test_inplace_function_copy_move() {
+    auto text = make_shared<string>("shared");
+    inplace_function<size_t()> f = [text]() { return text->size(); };
+    assert(text.use_count() == 2);
+
+    inplace_function<size_t()> copy = f;
+    assert(text.use_count() == 3 && copy() == 6);
+
+    inplace_function<size_t()> moved = std::move(copy);
+    assert(text.use_count() == 3 && moved() == 6);
+
+    moved = nullptr;
+    assert(text.use_count() == 2 && !moved);
+
+    f = [] { return size_t(7); };
+    assert(text.use_count() == 1 && f() == 7);
+
+    inplace_function<size_t()> empty;
+    assert(!empty);
+    try {
+        empty();
+        assert(false);
+    } catch (const bad_function_call&) {
+    }
+
+    // Null function pointers and empty 'std::function's are empty, too.
+    int (*null_function)(int) = nullptr;
+    inplace_function<int(int)> from_null = null_function;
+    inplace_function<int(int)> from_empty = function<int(int)>{};
+    assert(!from_null && !from_empty);
+    try {
+        from_null(1);
+        assert(false);
+    } catch (const bad_function_call&) {
+    }
+    inplace_function<int(int)> from_pointer = &triple;
+    assert(from_pointer && from_pointer(2) == 6);
+
+    // Moves can't throw, so a growing 'vector' moves instead of copying.
+    static_assert(is_nothrow_move_constructible<inplace_function<size_t()>>::value, "nothrow move");
+
+    // Larger captures need a larger capacity:
+    // inplace_function<int(), 8> too_small = [text, answer = 1]() { ... };  // Compile error.
+    double a = 1, b = 2, c = 3, d = 4, e = 5;
+    inplace_function<double(), 40> big = [a, b, c, d, e]() { return a + b + c + d + e; };
+    assert(big() == 15);
+}
+
+
+void test_inplace_function_never_allocates() {
+    int answer = 42;
+    double w1 = 1, w2 = 2, w3 = 3;
+    auto by_reference = [&](int x) { return x + answer + static_cast<int>(w1 + w2 + w3); };
+
+    size_t before = allocation_count;
+    function<int(int)> f = by_reference;
+    function<int(int)> f_copy = f;
+    assert(allocation_count == before + 2 && f_copy(0) == 48);   // 32 bytes of captures.
+
+    before = allocation_count;
+    inplace_function<int(int)> g = by_reference;
+    inplace_function<int(int)> g_copy = g;
+    inplace_function<int(int)> g_moved = std::move(g_copy);
+    g = g_moved;
+    assert(allocation_count == before && g(0) == 48);
+}
+
+
+static int apply_twice(function_ref<int(int)> f, int x) {
+    return f(f(x));
+}
+
+
+void test_function_ref() {
+    int answer = 42;
+    assert(apply_twice([answer](int x) { return x + answer; }, 0) == 84);
+    int calls = 0;
+    assert(apply_twice([&](int x) { ++calls; return x * 2; }, 1) == 4 && calls == 2);
+    assert(apply_twice(triple, 2) == 18);
+
+    inplace_function<int(int)> stored = [](int x) { return x - 1; };
+    assert(apply_twice(stored, 10) == 8);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: construct, copy and call capturing
+// lambdas through 'std::function',
+// 'inplace_function' and 'function_ref'.
+// Run with 'make bench'.
+//
+template<typename F>
+static double ns_per_op(size_t ops, F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+
+template<typename Wrapper, typename MakeLambda>
+void bench_wrapper(const char* name, MakeLambda make_lambda) {
+    const size_t n = 1000000;
+    long long sum = 0;
+
+    // Touch the memory of both vectors once, so page faults aren't measured.
+    vector<Wrapper> wrappers(n, Wrapper{make_lambda(0)});
+    vector<Wrapper> copies(wrappers);
+    wrappers.clear();
+    copies.clear();
+
+    size_t allocations = allocation_count;
+    double t_construct = ns_per_op(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            wrappers.emplace_back(make_lambda(static_cast<int>(i)));
+        }
+    });
+
+    double t_copy = ns_per_op(n, [&] {
+        for (auto& w : wrappers) {
+            copies.push_back(w);
+        }
+    });
+
+    allocations = allocation_count - allocations;
+
+    double t_call = ns_per_op(10 * n, [&] {
+        for (int round = 0; round < 10; ++round) {
+            for (auto& w : copies) {
+                sum += w(round);
+            }
+        }
+    });
+
+    double t_destroy = ns_per_op(2 * n, [&] {
+        wrappers.clear();
+        copies.clear();
+    });
+
+    cout << fixed << setprecision(2) << setw(30) << name << setw(11) << t_construct << setw(11) << t_copy
+         << setw(11) << t_call << setw(11) << t_destroy << setw(11) << static_cast<double>(allocations) / (2 * n)
+         << (sum == 0 ? "!" : "") << endl;
+}
+
+
+// Not inlined or specialized, so the call really goes through the 'function_ref'.
+__attribute__((noipa)) static long long call_through_ref(function_ref<int(int)> f, int rounds) {
+    long long sum = 0;
+    for (int round = 0; round < rounds; ++round) {
+        sum += f(round);
+    }
+    return sum;
+}
+
+
+void bench_inplace_function() {
+    int answer = 42;
+    double w1 = 1, w2 = 2, w3 = 3;
+    // [answer]: 4 bytes, fits everywhere. [&] with four variables: 32 bytes,
+    // which libstdc++'s 'std::function' puts on the heap.
+    auto by_value = [answer](int i) { return [answer, i](int x) { return x + answer + i; }; };
+    auto by_reference = [&](int i) {
+        (void)i;
+        return [&](int x) { return x + answer + static_cast<int>(w1 + w2 + w3); };
+    };
+
+    cout << "ns per operation and heap allocations per wrapper, 1M wrappers" << endl;
+    cout << setw(30) << "" << setw(11) << "construct" << setw(11) << "copy" << setw(11) << "call"
+         << setw(11) << "destroy" << setw(11) << "allocs" << endl;
+    bench_wrapper<function<int(int)>>("std::function [answer, i]", by_value);
+    bench_wrapper<inplace_function<int(int)>>("inplace_function [answer, i]", by_value);
+    bench_wrapper<function<int(int)>>("std::function [&]", by_reference);
+    bench_wrapper<inplace_function<int(int)>>("inplace_function [&]", by_reference);
+
+    // 'function_ref' only refers to a callable, so it's measured calling one.
+    auto lambda = by_reference(0);
+    const int rounds = 10000000;
+    long long sum = 0;
+    double t_ref = ns_per_op(rounds, [&] { sum += call_through_ref(lambda, rounds); });
+    cout << setw(30) << "function_ref [&]" << setw(11) << "-" << setw(11) << "-" << setw(11) << t_ref
+         << setw(11) << "-" << setw(11) << "-" << (sum == 0 ? "!" : "") << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_inplace_function_captures();
+    test_inplace_function_copy_move();
+    test_inplace_function_never_allocates();
+    test_function_ref();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_inplace_function();
+    }
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <limits>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Pulling numbers out of text with
+//
+//     for (sregex_iterator it(...); ...)
+//         stoi(it->str());
+//
+// runs a general regex engine to find each digit
+// run, copies it into a 'string' and parses it
+// digit by digit.
+//
+// 'number_scanner' does the same in a single pass
+// without allocations:
+//
+// 1. The next digit is found with SSE2 or AVX2
+//    range compares over 16 or 32 bytes at once
+//    (AVX2 is chosen at run-time if the CPU has it).
+// 2. From there, 8 bytes at a time are loaded into
+//    a 64-bit word. A SWAR ("SIMD within a register")
+//    test counts how many of them are digits, and a
+//    SWAR conversion turns up to 8 digits into their
+//    value with three multiplications -- the end of
+//    the run and its value come out of the same step.
+//
+// The SWAR code assumes a little-endian CPU.
+//
+struct number {
+    uint64_t value;     // UINT64_MAX if the run doesn't fit, like strtoull().
+    size_t offset;
+    size_t length;
+};
+
+
+namespace swar {
+
+const uint64_t zeros = 0x3030303030303030ULL;      // "00000000"
+
+// Number of leading (in memory order) digit bytes in 'chunk', 0..8.
+inline unsigned count_digits(uint64_t chunk) {
+    // A byte is a digit if its high nibble is 3 and its low nibble + 6 stays
+    // below 16. The low nibbles are masked first, so no carry crosses bytes.
+    uint64_t non_digit = ((chunk & 0xF0F0F0F0F0F0F0F0ULL) ^ zeros)
+                       | (((chunk & 0x0F0F0F0F0F0F0F0FULL) + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL);
+    return non_digit == 0 ? 8 : static_cast<unsigned>(__builtin_ctzll(non_digit)) / 8;
+}
+
+// Value of 8 ASCII digits; the first byte in memory is the most significant.
+inline uint64_t parse_eight_digits(uint64_t chunk) {
+    chunk -= zeros;
+    // Combine neighbouring digits into 2-digit values...
+    chunk = chunk * 10 + (chunk >> 8);
+    // ...then pairs of those into 4-digit values and those into the result.
+    return (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+          + (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+}
+
+// Value of the first 'count' (1..8) digits of 'chunk'.
+inline uint64_t parse_digits(uint64_t chunk, unsigned count) {
+    if (count < 8) {
+        // Move the digits to the top and fill the bottom with leading zeros.
+        chunk = (chunk << (8 * (8 - count))) | (zeros >> (8 * count));
+    }
+    return parse_eight_digits(chunk);
+}
+
+// Reads 8 bytes; past 'last', zero bytes (non-digits) are read instead.
+inline uint64_t load(const char* p, const char* last) {
+    uint64_t chunk = 0;
+    memcpy(&chunk, p, last - p >= 8 ? 8 : static_cast<size_t>(last - p));
+    return chunk;
+}
+
+}
+
+
+class number_scanner {
+public:
+    number_scanner() {
+#if defined(__x86_64__) || defined(__i386__)
+        use_avx2_ = __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // Calls 'on_number(number)' for each maximal run of digits in [first, last).
+    template<typename F>
+    void scan(const char* first, const char* last, F on_number) const {
+        static const uint64_t powers_of_ten[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        for (const char* p = find_digit(first, last); p != last; p = find_digit(p, last)) {
+            const char* start = p;
+            uint64_t value = 0;
+            bool overflow = false;
+            unsigned count;
+            do {
+                uint64_t chunk = swar::load(p, last);
+                count = swar::count_digits(chunk);
+                if (count == 0) {
+                    break;
+                }
+                uint64_t digits = swar::parse_digits(chunk, count);
+                overflow |= __builtin_mul_overflow(value, powers_of_ten[count], &value);
+                overflow |= __builtin_add_overflow(value, digits, &value);
+                p += count;
+            } while (count == 8);
+            on_number(number{overflow ? numeric_limits<uint64_t>::max() : value,
+                             static_cast<size_t>(start - first), static_cast<size_t>(p - start)});
+        }
+    }
+
+    vector<number> scan_all(const string& text) const {
+        vector<number> numbers;
+        scan(text.data(), text.data() + text.size(), [&numbers](const number& n) { numbers.push_back(n); });
+        return numbers;
+    }
+
+    // Returns the first digit in [first, last) or 'last'.
+    const char* find_digit(const char* first, const char* last) const {
+#if defined(__SSE2__)
+        if (use_avx2_) {
+            return find_digit_avx2(first, last);
+        }
+        return find_digit_sse2(first, last);
+#else
+        return find_digit_scalar(first, last);
+#endif
+    }
+
+    // Scalar version, also used for the tail of the vectorized ones.
+    static const char* find_digit_scalar(const char* first, const char* last) {
+        while (first != last && static_cast<unsigned char>(*first - '0') > 9) {
+            ++first;
+        }
+        return first;
+    }
+
+#if defined(__SSE2__)
+    static const char* find_digit_sse2(const char* first, const char* last) {
+        // Signed compares: bytes >= 0x80 are negative, i.e. below '0'.
+        const __m128i below = _mm_set1_epi8('0' - 1);
+        const __m128i above = _mm_set1_epi8('9' + 1);
+        const char* p = first;
+        for (; p + 16 <= last; p += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(c, below), _mm_cmplt_epi8(c, above)));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return find_digit_scalar(p, last);
+    }
+
+    __attribute__((target("avx2")))
+    static const char* find_digit_avx2(const char* first, const char* last) {
+        const __m256i below = _mm256_set1_epi8('0' - 1);
+        const __m256i above = _mm256_set1_epi8('9' + 1);
+        const char* p = first;
+        for (; p + 32 <= last; p += 32) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpgt_epi8(c, below), _mm256_cmpgt_epi8(above, c))));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return find_digit_sse2(p, last);
+    }
+#endif
+
+    bool uses_avx2() const { return use_avx2_; }
+
+private:
+    bool use_avx2_ = false;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_swar() {
+    uint64_t chunk;
+    memcpy(&chunk, "12345678", 8);
+    assert(swar::count_digits(chunk) == 8);
+    assert(swar::parse_eight_digits(chunk) == 12345678);
+
+    memcpy(&chunk, "907:abcd", 8);
+    assert(swar::count_digits(chunk) == 3);
+    assert(swar::parse_digits(chunk, 3) == 907);
+
+    // Neighbours of '0'..'9' in ASCII and bytes >= 0x80 are no digits.
+    for (int c = 0; c < 256; ++c) {
+        memcpy(&chunk, "5555555", 8);   // Seven digits and '\0'.
+        reinterpret_cast<unsigned char*>(&chunk)[0] = static_cast<unsigned char>(c);
+        assert(swar::count_digits(chunk) == ((c >= '0' && c <= '9') ? 7u : 0u));
+    }
+}
+
+
+void test_scan_numbers() {
+    // The example from the 'regex' chapter.
+    const string text("aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap");
+    number_scanner scanner;
+    auto numbers = scanner.scan_all(text);
+    assert(numbers.size() == 5);
+    const uint64_t values[] = { 1, 22, 333, 4444, 55555 };
+    for (size_t i = 0; i < 5; ++i) {
+        assert(numbers[i].value == values[i]);
+        assert(text.compare(numbers[i].offset, numbers[i].length, to_string(values[i])) == 0);
+    }
+
+    // Long runs, leading zeros, overflow, and a number right at the end.
+    auto big = scanner.scan_all("x18446744073709551615 18446744073709551616 0000000000000000000000042 12");
+    assert(big.size() == 4);
+    assert(big[0].value == 18446744073709551615ULL && big[0].offset == 1 && big[0].length == 20);
+    assert(big[1].value == numeric_limits<uint64_t>::max() && big[1].length == 20);
+    assert(big[2].value == 42 && big[2].length == 25);
+    assert(big[3].value == 12 && big[3].offset + big[3].length == 71);
+}
+
+
+void test_scan_vs_regex() {
+    // Random text: digits, their ASCII neighbours, UTF-8 bytes and spaces.
+    const char alphabet[] = "0123456789/:0123456789 a\xc3\xa4";
+    string text;
+    unsigned seed = 3;
+    for (int i = 0; i < 100000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        text += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+
+    const regex number_re{R"(\d+)"};
+    vector<number> expected;
+    for (sregex_iterator it(text.begin(), text.end(), number_re); it != sregex_iterator(); ++it) {
+        expected.push_back(number{strtoull(it->str().c_str(), nullptr, 10),
+                                  static_cast<size_t>(it->position()), static_cast<size_t>(it->length())});
+    }
+
+    // Every search variant finds the same runs.
+    number_scanner scanner;
+    auto actual = scanner.scan_all(text);
+    assert(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        assert(actual[i].value == expected[i].value);
+        assert(actual[i].offset == expected[i].offset && actual[i].length == expected[i].length);
+    }
+    const char* first = text.data();
+    const char* last = first + text.size();
+    for (const char* p = first; p != last; p = number_scanner::find_digit_scalar(p + 1, last)) {
+#if defined(__SSE2__)
+        assert(number_scanner::find_digit_sse2(p + 1, last) == number_scanner::find_digit_scalar(p + 1, last));
+        if (scanner.uses_avx2()) {
+            assert(number_scanner::find_digit_avx2(p + 1, last) == number_scanner::find_digit_scalar(p + 1, last));
+        }
+#endif
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: extracting all numbers from log lines
+// with 'sregex_iterator' + 'stoi', a 'strtoull'
+// loop and 'number_scanner'. Run with 'make bench';
+// pass the text size in MiB as second argument.
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void bench_number_scan(size_t mib) {
+    static const char* const words[] = { "GET", "/index.html", "status=", "bytes=", "user", "latency_ms=" };
+    string text;
+    unsigned seed = 11;
+    while (text.size() < mib * 1024 * 1024) {
+        seed = seed * 1103515245 + 12345;
+        text += "2024-01-01 12:34:56 ";
+        for (int w = 0; w < 4; ++w) {
+            seed = seed * 1103515245 + 12345;
+            text += words[(seed >> 16) % 6];
+            text += to_string(seed % (1u << ((seed >> 8) % 30 + 1)));     // 1 to 9 digits.
+            text += ' ';
+        }
+        text += '\n';
+    }
+    const double mb = text.size() / 1e6;
+    const char* first = text.data();
+    const char* last = first + text.size();
+
+    size_t count = 0;
+    uint64_t sum = 0;
+    double t_regex = seconds([&] {
+        const regex number_re{R"(\d+)"};
+        for (sregex_iterator it(text.begin(), text.end(), number_re); it != sregex_iterator(); ++it) {
+            sum += stoi(it->str());
+            ++count;
+        }
+    });
+    const size_t expected_count = count;
+    const uint64_t expected_sum = sum;
+
+    auto check = [&] {
+        assert(count == expected_count && sum == expected_sum);
+        count = 0;
+        sum = 0;
+    };
+    check();
+
+    double t_strtoull = seconds([&] {
+        // 'text' is null-terminated, so strtoull() stops at its end.
+        for (const char* p = number_scanner::find_digit_scalar(first, last); p != last;
+             p = number_scanner::find_digit_scalar(p, last)) {
+            char* end;
+            sum += strtoull(p, &end, 10);
+            ++count;
+            p = end;
+        }
+    });
+    check();
+
+    number_scanner scanner;
+    double t_scanner = seconds([&] {
+        scanner.scan(first, last, [&](const number& n) {
+            sum += n.value;
+            ++count;
+        });
+    });
+    check();
+
+    cout << mib << " MiB of log lines, " << expected_count << " numbers"
+         << (scanner.uses_avx2() ? " (AVX2)" : " (SSE2)") << endl;
+    cout << setw(24) << "" << setw(10) << "MB/s" << setw(14) << "M numbers/s" << endl;
+    auto row = [&](const char* name, double t) {
+        cout << setw(24) << name << fixed << setprecision(1) << setw(10) << mb / t
+             << setw(14) << expected_count / t / 1e6 << endl;
+    };
+    row("sregex_iterator + stoi", t_regex);
+    row("strtoull loop", t_strtoull);
+    row("number_scanner", t_scanner);
+}
+
+
+int main(int argc, char* argv[]) {
+    test_swar();
+    test_scan_numbers();
+    test_scan_vs_regex();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_number_scan(argc > 2 ? strtoul(argv[2], nullptr, 10) : 32);
+    }
+
+    return 0;
+}
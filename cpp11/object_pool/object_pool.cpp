@@ -0,0 +1,542 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'block_pool' hands out fixed-size blocks of raw
+// memory. Blocks are carved out of large chunks and
+// never returned to the heap before the pool dies;
+// released blocks are put on a free list instead.
+//
+// To keep threads from fighting over the pool's
+// mutex, every thread keeps a small cache of free
+// blocks per pool. Only when the cache runs empty
+// (or overflows) a whole batch of blocks is moved
+// between the cache and the shared free list.
+//
+class block_pool {
+public:
+    block_pool(size_t block_size, size_t block_align, size_t blocks_per_chunk = 256)
+        : block_size_{round_up(max(block_size, sizeof(node)), max(block_align, alignof(node)))},
+          block_align_{max(block_align, alignof(node))},
+          blocks_per_chunk_{blocks_per_chunk},
+          id_{next_id()} {
+        lock_guard<mutex> lock{registry_mutex()};
+        registry()[id_] = this;
+    }
+
+    block_pool(const block_pool&) = delete;
+    block_pool& operator=(const block_pool&) = delete;
+
+    ~block_pool() {
+        {
+        // Once unregistered, thread caches can no longer flush blocks to us.
+        lock_guard<mutex> lock{registry_mutex()};
+        registry().erase(id_);
+        }
+        for (auto chunk : chunks_) {
+            ::operator delete(chunk);
+        }
+    }
+
+    size_t block_size() const { return block_size_; }
+    size_t block_align() const { return block_align_; }
+
+    void* allocate() {
+        cache_entry& entry = local_entry();
+        if (entry.head == nullptr) {
+            refill(entry);
+        }
+        node* n = entry.head;
+        entry.head = n->next;
+        --entry.count;
+        return n;
+    }
+
+    void deallocate(void* p) {
+        cache_entry& entry = local_entry();
+        node* n = static_cast<node*>(p);
+        n->next = entry.head;
+        entry.head = n;
+        if (++entry.count > 2 * batch_size) {
+            drain(entry, batch_size);
+        }
+    }
+
+private:
+    struct node {
+        node* next;
+    };
+
+    // A thread's view on one pool: a singly-linked list of free blocks.
+    struct cache_entry {
+        uint64_t pool_id = 0;   // 0: unused entry.
+        node* head = nullptr;
+        size_t count = 0;
+    };
+
+    // Every thread caches blocks of up to 'cache_ways' different pools.
+    static const size_t cache_ways = 4;
+    static const size_t batch_size = 32;
+
+    struct thread_cache {
+        cache_entry entries[cache_ways];
+        size_t next_victim = 0;
+
+        ~thread_cache() {
+            for (auto& entry : entries) {
+                flush(entry);
+            }
+        }
+    };
+
+    static size_t round_up(size_t n, size_t align) {
+        return (n + align - 1) / align * align;
+    }
+
+    static uint64_t next_id() {
+        static atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    static mutex& registry_mutex() {
+        static mutex m;
+        return m;
+    }
+
+    static unordered_map<uint64_t, block_pool*>& registry() {
+        static unordered_map<uint64_t, block_pool*> pools;
+        return pools;
+    }
+
+    // Hands all cached blocks back to their pool -- if it's still alive.
+    static void flush(cache_entry& entry) {
+        if (entry.pool_id != 0) {
+            lock_guard<mutex> lock{registry_mutex()};
+            auto it = registry().find(entry.pool_id);
+            if (it != registry().end()) {
+                it->second->drain(entry, entry.count);
+            }
+        }
+        entry = cache_entry{};
+    }
+
+    cache_entry& local_entry() {
+        static thread_local thread_cache cache;
+        for (auto& entry : cache.entries) {
+            if (entry.pool_id == id_) {
+                return entry;
+            }
+        }
+        for (auto& entry : cache.entries) {
+            if (entry.pool_id == 0) {
+                entry.pool_id = id_;
+                return entry;
+            }
+        }
+        // All ways taken by other pools, evict one round-robin.
+        cache_entry& victim = cache.entries[cache.next_victim];
+        cache.next_victim = (cache.next_victim + 1) % cache_ways;
+        flush(victim);
+        victim.pool_id = id_;
+        return victim;
+    }
+
+    // Moves up to 'batch_size' blocks from the shared free list into 'entry'.
+    void refill(cache_entry& entry) {
+        lock_guard<mutex> lock{mutex_};
+        if (free_list_ == nullptr) {
+            grow();
+        }
+        for (size_t i = 0; i < batch_size && free_list_ != nullptr; ++i) {
+            node* n = free_list_;
+            free_list_ = n->next;
+            n->next = entry.head;
+            entry.head = n;
+            ++entry.count;
+        }
+    }
+
+    // Moves 'count' blocks from 'entry' to the shared free list.
+    void drain(cache_entry& entry, size_t count) {
+        lock_guard<mutex> lock{mutex_};
+        for (size_t i = 0; i < count && entry.head != nullptr; ++i) {
+            node* n = entry.head;
+            entry.head = n->next;
+            --entry.count;
+            n->next = free_list_;
+            free_list_ = n;
+        }
+    }
+
+    // Called with 'mutex_' held.
+    void grow() {
+        // Over-allocate so that the first block can be aligned.
+        size_t chunk_size = block_size_ * blocks_per_chunk_ + block_align_;
+        void* chunk = ::operator new(chunk_size);
+        chunks_.push_back(chunk);
+        void* first = chunk;
+        align(block_align_, block_size_ * blocks_per_chunk_, first, chunk_size);
+        char* block = static_cast<char*>(first);
+        for (size_t i = 0; i < blocks_per_chunk_; ++i, block += block_size_) {
+            node* n = reinterpret_cast<node*>(block);
+            n->next = free_list_;
+            free_list_ = n;
+        }
+    }
+
+    const size_t block_size_;
+    const size_t block_align_;
+    const size_t blocks_per_chunk_;
+    const uint64_t id_;
+
+    mutex mutex_;
+    node* free_list_ = nullptr;
+    vector<void*> chunks_;
+};
+
+
+//////////////////////////////////////////////////
+// 'object_pool' puts typed objects on top of
+// 'block_pool'. Objects are handed out as smart
+// pointers whose deleters return the memory to
+// the pool instead of calling 'delete':
+//
+// - 'make_unique' returns a 'unique_ptr<T, deleter>'.
+//   The deleter is just a pointer to the pool.
+// - 'make_shared' uses 'allocate_shared' with a pool
+//   allocator, so object and control block share a
+//   single pooled block.
+//
+// The pool must outlive all objects obtained from it.
+//
+template<typename T>
+class object_pool {
+public:
+    class deleter {
+    public:
+        deleter() = default;
+        explicit deleter(object_pool* pool) : pool_{pool} { }
+
+        void operator()(T* p) const {
+            p->~T();
+            pool_->objects_.deallocate(p);
+        }
+
+    private:
+        object_pool* pool_ = nullptr;
+    };
+
+    using unique_ptr_type = unique_ptr<T, deleter>;
+
+    // Minimal allocator, only used for the 'allocate_shared' path.
+    template<typename U>
+    class allocator {
+    public:
+        using value_type = U;
+
+        explicit allocator(object_pool* pool) : pool_{pool} { }
+        template<typename V>
+        allocator(const allocator<V>& other) : pool_{other.pool_} { }
+
+        U* allocate(size_t n) {
+            if (fits(n)) {
+                return static_cast<U*>(pool_->shared_blocks_.allocate());
+            }
+            return static_cast<U*>(::operator new(n * sizeof(U)));
+        }
+
+        void deallocate(U* p, size_t n) {
+            if (fits(n)) {
+                pool_->shared_blocks_.deallocate(p);
+            } else {
+                ::operator delete(p);
+            }
+        }
+
+        template<typename V>
+        bool operator==(const allocator<V>& other) const { return pool_ == other.pool_; }
+        template<typename V>
+        bool operator!=(const allocator<V>& other) const { return pool_ != other.pool_; }
+
+    private:
+        template<typename V> friend class allocator;
+
+        // The control block type is implementation-defined, so we can only
+        // check at run-time whether it fits into a pooled block.
+        bool fits(size_t n) const {
+            return n == 1 && sizeof(U) <= pool_->shared_blocks_.block_size()
+                && alignof(U) <= pool_->shared_blocks_.block_align();
+        }
+
+        object_pool* pool_;
+    };
+
+    explicit object_pool(size_t objects_per_chunk = 256)
+        : objects_{sizeof(T), alignof(T), objects_per_chunk},
+          // Room for T plus reference counts and a vtable pointer.
+          shared_blocks_{sizeof(T) + shared_overhead, alignof(max_align_t), objects_per_chunk} {
+    }
+
+    template<typename... Args>
+    unique_ptr_type make_unique(Args&&... args) {
+        void* memory = objects_.allocate();
+        try {
+            return unique_ptr_type{new (memory) T(std::forward<Args>(args)...), deleter{this}};
+        } catch (...) {
+            objects_.deallocate(memory);
+            throw;
+        }
+    }
+
+    template<typename... Args>
+    shared_ptr<T> make_shared(Args&&... args) {
+        return allocate_shared<T>(allocator<T>{this}, std::forward<Args>(args)...);
+    }
+
+private:
+    static const size_t shared_overhead = 8 * sizeof(void*);
+
+    block_pool objects_;
+    block_pool shared_blocks_;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+struct tracked {
+    static atomic<int> alive;
+
+    explicit tracked(int v) : value{v} { ++alive; }
+    ~tracked() { --alive; }
+
+    int value;
+    char payload[40];
+};
+
+atomic<int> tracked::alive{0};
+
+
+void test_unique_ptr_from_pool() {
+    object_pool<tracked> pool;
+
+    void* first_address;
+    {
+    auto p = pool.make_unique(42);
+    assert(p->value == 42);
+    assert(tracked::alive == 1);
+    first_address = p.get();
+    } // Deleter destroys the object and hands the memory back to the pool.
+    assert(tracked::alive == 0);
+
+    // The free list is LIFO, so the very same block is reused.
+    auto p = pool.make_unique(23);
+    assert(p.get() == first_address);
+    assert(p->value == 23);
+
+    // Pooled unique pointers move just like plain ones.
+    object_pool<tracked>::unique_ptr_type q = std::move(p);
+    assert(!p);
+    assert(q->value == 23);
+    q.reset();
+    assert(tracked::alive == 0);
+}
+
+
+void test_shared_ptr_from_pool() {
+    object_pool<tracked> pool;
+
+    void* first_address;
+    {
+    shared_ptr<tracked> sp1 = pool.make_shared(42);
+    shared_ptr<tracked> sp2 = sp1;
+    assert(sp1.use_count() == 2);
+    assert(tracked::alive == 1);
+    first_address = sp1.get();
+    }
+    assert(tracked::alive == 0);
+
+    // Object and control block came from one pooled block, which is reused.
+    shared_ptr<tracked> sp = pool.make_shared(23);
+    assert(sp.get() == first_address);
+
+    // Weak pointers keep the control block -- and thus the block -- alive.
+    weak_ptr<tracked> wp = sp;
+    sp.reset();
+    assert(tracked::alive == 0);
+    assert(wp.expired());
+    sp = pool.make_shared(7);
+    assert(sp.get() != first_address);
+}
+
+
+void test_pool_growth() {
+    // Small chunks, so that the pool has to grow several times.
+    object_pool<tracked> pool{8};
+    vector<object_pool<tracked>::unique_ptr_type> objects;
+    for (int i = 0; i < 1000; ++i) {
+        objects.push_back(pool.make_unique(i));
+    }
+    assert(tracked::alive == 1000);
+    for (int i = 0; i < 1000; ++i) {
+        assert(objects[i]->value == i);
+        // Blocks of 44 bytes are rounded up, so the free list's links stay aligned.
+        assert(reinterpret_cast<uintptr_t>(objects[i].get()) % alignof(void*) == 0);
+    }
+    objects.clear();
+    assert(tracked::alive == 0);
+}
+
+
+void test_pool_concurrent_churn() {
+    object_pool<tracked> pool;
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, t] {
+            vector<object_pool<tracked>::unique_ptr_type> mine;
+            vector<shared_ptr<tracked>> shared;
+            for (int round = 0; round < 100; ++round) {
+                for (int i = 0; i < 50; ++i) {
+                    mine.push_back(pool.make_unique(t));
+                    shared.push_back(pool.make_shared(t));
+                }
+                for (auto& p : mine) {
+                    assert(p->value == t);
+                }
+                mine.clear();
+                shared.clear();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(tracked::alive == 0);
+}
+
+
+void test_objects_released_by_other_threads() {
+    object_pool<tracked> pool;
+    vector<object_pool<tracked>::unique_ptr_type> objects;
+    for (int i = 0; i < 500; ++i) {
+        objects.push_back(pool.make_unique(i));
+    }
+    // Blocks migrate to the releasing thread's cache and are flushed back to
+    // the pool when that thread exits.
+    thread releaser{[&objects] { objects.clear(); }};
+    releaser.join();
+    assert(tracked::alive == 0);
+
+    for (int i = 0; i < 500; ++i) {
+        objects.push_back(pool.make_unique(i));
+    }
+    objects.clear();
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: acquire/release churn with 1..N
+// threads, pool vs. plain new/delete and
+// make_shared. Run with 'make bench'.
+//
+template<typename F>
+static double time_ms(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+
+// Runs 'body' on 'thread_count' threads and returns ns per acquire/release pair.
+template<typename F>
+static double churn(unsigned thread_count, size_t ops_per_thread, F body) {
+    double ms = time_ms([&] {
+        vector<thread> threads;
+        for (unsigned t = 0; t < thread_count; ++t) {
+            threads.emplace_back(body);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    });
+    return ms * 1e6 / (double(ops_per_thread) * thread_count);
+}
+
+
+void bench_object_pool() {
+    const size_t live = 64;         // Objects held at a time per thread.
+    const size_t rounds = 20000;
+    const size_t ops = live * rounds;
+    unsigned max_threads = max(4u, thread::hardware_concurrency());
+
+    cout << "acquire/release, ns per op (" << live << " live objects per thread)" << endl;
+    cout << setw(8) << "threads" << setw(12) << "new/delete" << setw(12) << "pool uniq"
+         << setw(14) << "make_shared" << setw(12) << "pool shrd" << endl;
+
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        object_pool<tracked> pool;
+
+        double plain = churn(threads, ops, [&] {
+            vector<tracked*> objects(live);
+            for (size_t r = 0; r < rounds; ++r) {
+                for (auto& p : objects) p = new tracked{int(r)};
+                for (auto p : objects) delete p;
+            }
+        });
+        double pooled = churn(threads, ops, [&] {
+            vector<object_pool<tracked>::unique_ptr_type> objects(live);
+            for (size_t r = 0; r < rounds; ++r) {
+                for (auto& p : objects) p = pool.make_unique(int(r));
+                for (auto& p : objects) p.reset();
+            }
+        });
+        double shared = churn(threads, ops, [&] {
+            vector<shared_ptr<tracked>> objects(live);
+            for (size_t r = 0; r < rounds; ++r) {
+                for (auto& p : objects) p = std::make_shared<tracked>(int(r));
+                for (auto& p : objects) p.reset();
+            }
+        });
+        double pooled_shared = churn(threads, ops, [&] {
+            vector<shared_ptr<tracked>> objects(live);
+            for (size_t r = 0; r < rounds; ++r) {
+                for (auto& p : objects) p = pool.make_shared(int(r));
+                for (auto& p : objects) p.reset();
+            }
+        });
+
+        cout << fixed << setprecision(1)
+             << setw(8) << threads << setw(12) << plain << setw(12) << pooled
+             << setw(14) << shared << setw(12) << pooled_shared << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_unique_ptr_from_pool();
+    test_shared_ptr_from_pool();
+    test_pool_growth();
+    test_pool_concurrent_churn();
+    test_objects_released_by_other_threads();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_object_pool();
+    }
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// C++17 adds execution policies to the standard
+// algorithms, but C++11 only has 'std::thread'.
+// The 'par' namespace has parallel versions of the
+// algorithms from the 'odds_and_ends' chapter that
+// split their range into one chunk per thread:
+//
+// - 'any_of', 'all_of' and 'none_of' stop early.
+//   The first thread that decides the result sets a
+//   shared atomic flag, which the others check every
+//   few thousand elements, so they give up on the
+//   rest of their chunks.
+// - 'copy_if' keeps the order of the elements with
+//   two passes: each thread counts the matches in
+//   its chunk, an (exclusive) prefix sum over the
+//   counts gives each chunk its output position,
+//   and then each thread copies its matches there.
+//   The predicate is called twice per element, so
+//   it must not have side effects. The output must
+//   be random access and large enough, like the
+//   output of 'std::copy' -- 'back_inserter' can't
+//   be written to in parallel.
+// - 'iota' gives each chunk its start value.
+//
+// All take the number of threads as the last
+// argument; 0 means one per hardware thread.
+//
+namespace par {
+
+namespace detail {
+
+inline size_t thread_count(unsigned threads, size_t size) {
+    size_t n = threads != 0 ? threads : max(1u, thread::hardware_concurrency());
+    return max<size_t>(1, min(n, size));
+}
+
+// Calls 'f(chunk, begin, end)' for each of 'chunks' chunks of [0, size), one
+// thread per chunk. The calling thread takes the first chunk.
+template<typename F>
+void for_each_chunk(size_t size, size_t chunks, F f) {
+    vector<thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back(f, chunk, chunk * size / chunks, (chunk + 1) * size / chunks);
+    }
+    f(0, 0, size / chunks);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// How many elements a thread checks between looks at the 'found' flag.
+const size_t check_interval = 4096;
+
+}   // namespace detail
+
+
+template<typename It, typename Pred>
+bool any_of(It first, It last, Pred pred, unsigned threads = 0) {
+    size_t size = static_cast<size_t>(last - first);
+    atomic<bool> found{false};
+    detail::for_each_chunk(size, detail::thread_count(threads, size), [&](size_t, size_t begin, size_t end) {
+        while (begin != end && !found.load(memory_order_relaxed)) {
+            size_t block_end = min(end, begin + detail::check_interval);
+            if (std::any_of(first + begin, first + block_end, pred)) {
+                found.store(true, memory_order_relaxed);
+                return;
+            }
+            begin = block_end;
+        }
+    });
+    return found.load();
+}
+
+
+template<typename It, typename Pred>
+bool none_of(It first, It last, Pred pred, unsigned threads = 0) {
+    return !par::any_of(first, last, pred, threads);
+}
+
+
+template<typename It, typename Pred>
+bool all_of(It first, It last, Pred pred, unsigned threads = 0) {
+    typedef typename iterator_traits<It>::reference reference;
+    return !par::any_of(first, last, [&pred](reference x) { return !pred(x); }, threads);
+}
+
+
+template<typename InIt, typename OutIt, typename Pred>
+OutIt copy_if(InIt first, InIt last, OutIt out, Pred pred, unsigned threads = 0) {
+    typedef typename iterator_traits<InIt>::reference reference;
+    size_t size = static_cast<size_t>(last - first);
+    size_t chunks = detail::thread_count(threads, size);
+    if (chunks == 1) {
+        return std::copy_if(first, last, out, pred);    // One pass is enough.
+    }
+
+    // Pass 1: matches per chunk.
+    vector<size_t> offsets(chunks + 1, 0);
+    detail::for_each_chunk(size, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        offsets[chunk + 1] = static_cast<size_t>(std::count_if(first + begin, first + end, pred));
+    });
+
+    // Exclusive prefix sum: where each chunk's matches go.
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    // Pass 2: each chunk copies to its own part of the output.
+    detail::for_each_chunk(size, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        OutIt o = out + offsets[chunk];
+        for_each(first + begin, first + end, [&o, &pred](reference x) {
+            if (pred(x)) {
+                *o++ = x;
+            }
+        });
+    });
+    return out + offsets[chunks];
+}
+
+
+template<typename It, typename T>
+void iota(It first, It last, T value, unsigned threads = 0) {
+    size_t size = static_cast<size_t>(last - first);
+    detail::for_each_chunk(size, detail::thread_count(threads, size), [&](size_t, size_t begin, size_t end) {
+        std::iota(first + begin, first + end, static_cast<T>(value + begin));
+    });
+}
+
+}   // namespace par
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_parallel_algorithms_primes() {
+    // The examples from the 'odds_and_ends' chapter.
+    const vector<int> primes{2, 3, 5, 7, 11, 13, 17, 19};
+    for (unsigned threads : { 1, 2, 3, 8, 16, 0 }) {
+        assert(par::all_of(primes.begin(), primes.end(), [](int v) { return v > 0; }, threads));
+        assert(par::any_of(primes.begin(), primes.end(), [](int v) { return (v % 2) == 0; }, threads));
+        assert(par::none_of(primes.begin(), primes.end(), [](int v) { return v > 1000; }, threads));
+        assert(!par::all_of(primes.begin(), primes.end(), [](int v) { return v > 2; }, threads));
+        assert(!par::none_of(primes.begin(), primes.end(), [](int v) { return v == 19; }, threads));
+
+        vector<int> even_primes(primes.size());
+        auto end = par::copy_if(primes.begin(), primes.end(), even_primes.begin(), [](int v) { return (v % 2) == 0; }, threads);
+        even_primes.erase(end, even_primes.end());
+        assert(even_primes.size() == 1 && even_primes.front() == 2);
+
+        vector<int> hundred_plus(5);
+        par::iota(hundred_plus.begin(), hundred_plus.end(), 100, threads);
+        assert(hundred_plus[0] == 100);
+        assert(hundred_plus[4] == 104);
+    }
+
+    // Empty ranges.
+    vector<int> empty;
+    assert(par::all_of(empty.begin(), empty.end(), [](int) { return false; }, 4));
+    assert(!par::any_of(empty.begin(), empty.end(), [](int) { return true; }, 4));
+    assert(par::copy_if(empty.begin(), empty.end(), empty.begin(), [](int) { return true; }, 4) == empty.begin());
+}
+
+
+void test_parallel_algorithms_large() {
+    const size_t n = 1000003;
+    vector<int> v(n);
+    par::iota(v.begin(), v.end(), -7, 7);
+    vector<int> expected(n);
+    iota(expected.begin(), expected.end(), -7);
+    assert(v == expected);
+
+    // Order is kept.
+    auto pred = [](int x) { return x % 3 == 0 || (x > 500000 && x < 500100); };
+    vector<int> sequential;
+    copy_if(v.begin(), v.end(), back_inserter(sequential), pred);
+    for (unsigned threads : { 1, 2, 5, 8 }) {
+        vector<int> parallel(n);
+        parallel.erase(par::copy_if(v.begin(), v.end(), parallel.begin(), pred, threads), parallel.end());
+        assert(parallel == sequential);
+    }
+
+    // A match early in the first chunk stops the other threads after their
+    // first block, where the predicate is slowed down. Without the checks of
+    // the flag, they'd go through all of their chunks.
+    atomic<size_t> calls{0};
+    const int first_chunk_end = static_cast<int>(n / 4) - 7;
+    assert(par::any_of(v.begin(), v.end(), [&calls, first_chunk_end](int x) {
+        ++calls;
+        if (x >= first_chunk_end && x % 1024 == 0) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        return x == 3;
+    }, 4));
+    assert(calls < n / 2);
+    assert(!par::any_of(v.begin(), v.end(), [](int x) { return x > 2000000; }, 4));
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: the parallel algorithms with 1..N
+// threads vs. the sequential standard ones.
+// Run with 'make bench'; the size (default 100M
+// ints) can be given as a second argument.
+//
+template<typename F>
+static double ms(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+
+void bench_parallel_algorithms(size_t n) {
+    vector<int> v(n);
+    vector<int> out(n);
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+
+    cout << "ms (speedup over the sequential std:: algorithm), " << n << " ints, "
+         << hardware << " hardware threads" << endl;
+    cout << setw(12) << "threads" << setw(18) << "iota" << setw(18) << "none_of (full)"
+         << setw(18) << "any_of (middle)" << setw(18) << "copy_if (50%)" << endl;
+
+    auto is_odd = [](int x) { return (x & 1) != 0; };
+    auto is_middle = [n](int x) { return x == static_cast<int>(n / 2); };
+    auto is_negative = [](int x) { return x < 0; };
+
+    size_t true_results = 0, rows = 1;
+    size_t copied = 0;
+    double seq_iota = ms([&] { iota(v.begin(), v.end(), 0); });
+    double seq_none = ms([&] { true_results += none_of(v.begin(), v.end(), is_negative); });
+    double seq_any = ms([&] { true_results += any_of(v.begin(), v.end(), is_middle); });
+    double seq_copy = ms([&] { copied += copy_if(v.begin(), v.end(), out.begin(), is_odd) - out.begin(); });
+
+    auto print = [](double t, double sequential) {
+        cout << setw(10) << t << " (" << setw(4) << sequential / t << "x)";
+    };
+    cout << fixed << setprecision(1) << setw(12) << "std::";
+    cout << setw(18) << seq_iota << setw(18) << seq_none << setw(18) << seq_any << setw(18) << seq_copy << endl;
+
+    for (unsigned threads = 1; threads <= max(4u, hardware); threads *= 2) {
+        double t_iota = ms([&] { par::iota(v.begin(), v.end(), 0, threads); });
+        double t_none = ms([&] { true_results += par::none_of(v.begin(), v.end(), is_negative, threads); });
+        double t_any = ms([&] { true_results += par::any_of(v.begin(), v.end(), is_middle, threads); });
+        double t_copy = ms([&] { copied += par::copy_if(v.begin(), v.end(), out.begin(), is_odd, threads) - out.begin(); });
+        cout << setw(12) << threads;
+        print(t_iota, seq_iota);
+        print(t_none, seq_none);
+        print(t_any, seq_any);
+        print(t_copy, seq_copy);
+        cout << endl;
+        ++rows;
+    }
+    assert(true_results == 2 * rows);
+    assert(copied == rows * (n / 2));
+}
+
+
+int main(int argc, char* argv[]) {
+    test_parallel_algorithms_primes();
+    test_parallel_algorithms_large();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_parallel_algorithms(argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000000);
+    }
+
+    return 0;
+}
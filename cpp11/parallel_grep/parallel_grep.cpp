@@ -0,0 +1,386 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <system_error>
+#include <chrono>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Reading a file with 'getline' copies every line
+// into a 'string' before 'regex_search' sees it,
+// and uses a single core.
+//
+// 'mapped_file' maps the file read-only into the
+// address space instead; 'parallel_grep' splits
+// the mapping into newline-aligned chunks, searches
+// them concurrently, and concatenates the per-chunk
+// results, so matches come out in file order.
+//
+// Lines are searched in place -- 'regex_search'
+// works on 'const char*' ranges -- and matches
+// point into the mapping. They stay valid as long
+// as the 'mapped_file' lives.
+//
+class mapped_file {
+public:
+    explicit mapped_file(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw system_error{errno, system_category(), "open " + path};
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            int error = errno;
+            close(fd);
+            throw system_error{error, system_category(), "fstat " + path};
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            // An empty file can't be mapped; it simply has no data.
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int error = errno;
+                close(fd);
+                throw system_error{error, system_category(), "mmap " + path};
+            }
+            data_ = static_cast<const char*>(p);
+            // Chunks are read front to back; let the kernel read ahead.
+            madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        // The mapping keeps the file referenced.
+        close(fd);
+    }
+
+    ~mapped_file() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+struct grep_match {
+    size_t line_number;     // 1-based, like grep -n.
+    const char* line;       // Start of the matching line, without '\n'.
+    size_t length;
+
+    string str() const { return string(line, length); }
+};
+
+
+struct text_chunk {
+    const char* first;
+    const char* last;
+};
+
+
+// Splits [data, data + size) into at most 'count' pieces, each ending
+// right behind a '\n' (or at the end of the data).
+vector<text_chunk> split_lines(const char* data, size_t size, size_t count) {
+    vector<text_chunk> chunks;
+    const char* end = data + size;
+    const char* first = data;
+    for (size_t i = 1; i <= count && first != end; ++i) {
+        const char* last = i == count ? end : max(first, data + size / count * i);
+        if (last != end) {
+            const char* nl = static_cast<const char*>(memchr(last, '\n', end - last));
+            last = nl ? nl + 1 : end;
+        }
+        if (last != first) {
+            chunks.push_back(text_chunk{first, last});
+        }
+        first = last;
+    }
+    return chunks;
+}
+
+
+namespace detail {
+
+// Searches all lines of one chunk; line numbers are relative to the chunk.
+size_t grep_chunk(text_chunk chunk, const regex& re, vector<grep_match>& matches) {
+    size_t lines = 0;
+    for (const char* line = chunk.first; line != chunk.last; ) {
+        const char* nl = static_cast<const char*>(memchr(line, '\n', chunk.last - line));
+        const char* line_end = nl ? nl : chunk.last;
+        ++lines;
+        if (regex_search(line, line_end, re)) {
+            matches.push_back(grep_match{lines, line, static_cast<size_t>(line_end - line)});
+        }
+        line = nl ? nl + 1 : chunk.last;
+    }
+    return lines;
+}
+
+}
+
+
+vector<grep_match> parallel_grep(const char* data, size_t size, const regex& re,
+                                 unsigned threads = max(1u, thread::hardware_concurrency())) {
+    auto chunks = split_lines(data, size, threads);
+    vector<vector<grep_match>> results(chunks.size());
+    vector<size_t> line_counts(chunks.size());
+
+    // Matching against a 'const regex' from several threads is safe.
+    vector<thread> workers;
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        workers.emplace_back([&, i] { line_counts[i] = detail::grep_chunk(chunks[i], re, results[i]); });
+    }
+    if (!chunks.empty()) {
+        line_counts[0] = detail::grep_chunk(chunks[0], re, results[0]);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    // Merge in file order, turning chunk-relative into absolute line numbers.
+    size_t total = 0;
+    for (auto& r : results) {
+        total += r.size();
+    }
+    vector<grep_match> matches;
+    matches.reserve(total);
+    size_t lines_before = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        for (auto& m : results[i]) {
+            matches.push_back(grep_match{m.line_number + lines_before, m.line, m.length});
+        }
+        lines_before += line_counts[i];
+    }
+    return matches;
+}
+
+
+inline vector<grep_match> parallel_grep(const mapped_file& file, const regex& re,
+                                        unsigned threads = max(1u, thread::hardware_concurrency())) {
+    return parallel_grep(file.data(), file.size(), re, threads);
+}
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+static string temp_path(const char* name) {
+    return string("/tmp/parallel_grep_") + to_string(getpid()) + "_" + name;
+}
+
+
+static void write_file(const string& path, const string& content) {
+    ofstream out(path, ios::binary);
+    out << content;
+}
+
+
+// Reference result: getline + regex_search.
+static vector<pair<size_t, string>> getline_grep(const string& path, const regex& re) {
+    vector<pair<size_t, string>> matches;
+    ifstream in(path);
+    string line;
+    for (size_t n = 1; getline(in, line); ++n) {
+        if (regex_search(line, re)) {
+            matches.push_back(make_pair(n, line));
+        }
+    }
+    return matches;
+}
+
+
+void test_split_lines() {
+    const string text("aaa\nbb\nc\n\ndddd\ne");
+    for (size_t count = 1; count <= 20; ++count) {
+        auto chunks = split_lines(text.data(), text.size(), count);
+        assert(chunks.size() <= count);
+        // Chunks cover the text without gaps and end on line boundaries.
+        const char* expected = text.data();
+        for (auto& c : chunks) {
+            assert(c.first == expected && c.last > c.first);
+            assert(c.last == text.data() + text.size() || c.last[-1] == '\n');
+            expected = c.last;
+        }
+        assert(expected == text.data() + text.size());
+    }
+    assert(split_lines(text.data(), 0, 4).empty());
+}
+
+
+void test_parallel_grep_file() {
+    const string path = temp_path("test.txt");
+    string content;
+    for (int i = 0; i < 1000; ++i) {
+        content += "line " + to_string(i) + ((i % 7 == 0) ? " ERROR disk full\n" : " INFO ok\n");
+    }
+    content += "last line without newline ERROR";
+    write_file(path, content);
+
+    const regex error_re{R"(ERROR( disk)?)"};
+    auto expected = getline_grep(path, error_re);
+    assert(expected.size() == 144);
+    {
+        mapped_file file(path);
+        assert(file.size() == content.size());
+        for (unsigned threads : { 1u, 2u, 3u, 8u, 64u }) {
+            auto matches = parallel_grep(file, error_re, threads);
+            assert(matches.size() == expected.size());
+            for (size_t i = 0; i < matches.size(); ++i) {
+                assert(matches[i].line_number == expected[i].first);
+                assert(matches[i].str() == expected[i].second);
+            }
+            // Zero-copy: matches point into the mapping.
+            assert(matches[0].line >= file.data() && matches[0].line < file.data() + file.size());
+        }
+    }
+    unlink(path.c_str());
+}
+
+
+void test_mapped_file_errors() {
+    const string path = temp_path("empty.txt");
+    write_file(path, "");
+    {
+        mapped_file file(path);
+        assert(file.size() == 0);
+        assert(parallel_grep(file, regex("x")).empty());
+    }
+    unlink(path.c_str());
+
+    try {
+        mapped_file file(temp_path("does_not_exist"));
+        assert(false);
+    } catch (const system_error& e) {
+        assert(e.code().value() == ENOENT);
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: GB/s of 'parallel_grep' with 1..N
+// threads vs. 'ifstream' + 'getline' +
+// 'regex_search' over a generated log file.
+// Run with 'make bench'; pass the file size in MiB
+// as second argument (default 256; use a few
+// thousand for multi-GB files).
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void bench_parallel_grep(size_t mib) {
+    const string path = temp_path("bench.log");
+    {
+        static const char* const levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+        static const char* const texts[] = { "request served", "cache miss", "disk full", "retrying",
+                                             "connection reset by peer", "user logged in" };
+        ofstream out(path, ios::binary);
+        unsigned seed = 7;
+        string line;
+        for (size_t bytes = 0; bytes < mib * 1024 * 1024; bytes += line.size()) {
+            seed = seed * 1103515245 + 12345;
+            line = "2024-01-01 12:" + to_string(seed % 60) + ":" + to_string((seed >> 8) % 60) + " "
+                 + levels[(seed >> 12) % 4] + " " + texts[(seed >> 16) % 6] + " id=" + to_string(seed % 100000) + "\n";
+            out << line;
+        }
+    }
+
+    const regex re{R"(ERROR.*disk)"};
+
+    size_t n_getline = 0;
+    double t_getline = seconds([&] { n_getline = getline_grep(path, re).size(); });
+
+    mapped_file file(path);
+    const double gb = file.size() / 1e9;
+    cout << "GB/s, " << file.size() / (1024 * 1024) << " MiB log file, pattern ERROR.*disk, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(22) << "getline+regex_search" << fixed << setprecision(3) << setw(10) << gb / t_getline << endl;
+
+    double t_one = 0;
+    unsigned max_threads = max(8u, thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        size_t n = 0;
+        double t = seconds([&] { n = parallel_grep(file, re, threads).size(); });
+        assert(n == n_getline);
+        if (threads == 1) {
+            t_one = t;
+        }
+        cout << setw(14) << "parallel_grep" << setw(4) << threads << " t" << setw(12) << gb / t
+             << "  speedup " << setprecision(2) << t_one / t << setprecision(3) << endl;
+    }
+    unlink(path.c_str());
+}
+
+
+//////////////////////////////////////////////////
+// Usage as a tool:
+//
+//     ./parallel_grep grep PATTERN FILE [THREADS]
+//
+// prints matching lines prefixed by their number.
+//
+int grep_main(int argc, char* argv[]) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " grep PATTERN FILE [THREADS]" << endl;
+        return 2;
+    }
+    try {
+        const regex re{argv[2]};
+        mapped_file file(argv[3]);
+        unsigned threads = argc > 4 ? strtoul(argv[4], nullptr, 10) : thread::hardware_concurrency();
+        auto matches = parallel_grep(file, re, max(1u, threads));
+        for (auto& m : matches) {
+            cout << m.line_number << ':';
+            cout.write(m.line, m.length);
+            cout << '\n';
+        }
+        return matches.empty() ? 1 : 0;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "grep") == 0) {
+        return grep_main(argc, argv);
+    }
+
+    test_split_lines();
+    test_parallel_grep_file();
+    test_mapped_file_errors();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_parallel_grep(argc > 2 ? strtoul(argv[2], nullptr, 10) : 256);
+    }
+
+    return 0;
+}
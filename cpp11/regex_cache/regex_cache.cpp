@@ -0,0 +1,302 @@
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+
+#include <regex>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Constructing a 'std::regex' parses the pattern
+// and builds an automaton, which typically costs
+// far more than matching a short text. Code like
+//
+//     regex_search(text, regex("dog"))
+//
+// pays that price on every call. 'regex_cache'
+// keeps the most recently used compiled regexes,
+// keyed by pattern and flags, and evicts the least
+// recently used one when full.
+//
+// Cached regexes are handed out as
+// 'shared_ptr<const regex>', so a regex that gets
+// evicted while another thread still uses it stays
+// alive until that thread is done. Matching against
+// a 'const regex' from several threads is safe.
+//
+class regex_cache {
+public:
+    using flag_type = regex_constants::syntax_option_type;
+
+    explicit regex_cache(size_t capacity = 64) : capacity_{capacity} {
+        assert(capacity_ > 0);
+    }
+
+    shared_ptr<const regex> get(const string& pattern, flag_type flags = regex_constants::ECMAScript) {
+        key k{pattern, flags};
+        {
+        lock_guard<mutex> lock{mutex_};
+        auto it = index_.find(k);
+        if (it != index_.end()) {
+            // Hit: move entry to the front (most recently used).
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++hits_;
+            return it->second->second;
+        }
+        ++misses_;
+        }
+
+        // Compile outside the lock, so that a slow compilation doesn't
+        // stall hits of other threads. May throw 'regex_error'.
+        auto compiled = make_shared<const regex>(pattern, flags);
+
+        lock_guard<mutex> lock{mutex_};
+        auto it = index_.find(k);
+        if (it != index_.end()) {
+            // Another thread was faster.
+            return it->second->second;
+        }
+        lru_.emplace_front(k, compiled);
+        index_[k] = lru_.begin();
+        if (lru_.size() > capacity_) {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        return compiled;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> lock{mutex_};
+        return lru_.size();
+    }
+
+    size_t hits() const {
+        lock_guard<mutex> lock{mutex_};
+        return hits_;
+    }
+
+    size_t misses() const {
+        lock_guard<mutex> lock{mutex_};
+        return misses_;
+    }
+
+private:
+    struct key {
+        string pattern;
+        flag_type flags;
+
+        bool operator==(const key& other) const {
+            return flags == other.flags && pattern == other.pattern;
+        }
+    };
+
+    struct key_hash {
+        size_t operator()(const key& k) const {
+            return hash<string>()(k.pattern) * 31 + static_cast<size_t>(k.flags);
+        }
+    };
+
+    using entry = pair<key, shared_ptr<const regex>>;
+
+    const size_t capacity_;
+    mutable mutex mutex_;
+    list<entry> lru_;
+    unordered_map<key, list<entry>::iterator, key_hash> index_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+
+//////////////////////////////////////////////////
+// Drop-in helpers that look like their 'std::'
+// counterparts but take the pattern as a string.
+// They share one process-wide cache.
+//
+regex_cache& default_regex_cache() {
+    static regex_cache cache;
+    return cache;
+}
+
+
+bool cached_search(const string& text, const string& pattern,
+                   regex_cache::flag_type flags = regex_constants::ECMAScript) {
+    return regex_search(text, *default_regex_cache().get(pattern, flags));
+}
+
+
+bool cached_search(const string& text, smatch& match_results, const string& pattern,
+                   regex_cache::flag_type flags = regex_constants::ECMAScript) {
+    return regex_search(text, match_results, *default_regex_cache().get(pattern, flags));
+}
+
+// Like 'std::regex_search': 'match_results' would point into the destroyed
+// temporary.
+bool cached_search(const string&&, smatch&, const string&,
+                   regex_cache::flag_type = regex_constants::ECMAScript) = delete;
+
+
+bool cached_match(const string& text, const string& pattern,
+                  regex_cache::flag_type flags = regex_constants::ECMAScript) {
+    return regex_match(text, *default_regex_cache().get(pattern, flags));
+}
+
+
+string cached_replace(const string& text, const string& pattern, const string& replacement,
+                      regex_cache::flag_type flags = regex_constants::ECMAScript) {
+    return regex_replace(text, *default_regex_cache().get(pattern, flags), replacement);
+}
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_cached_helpers() {
+    // Same checks as in the 'regex' chapter, but each pattern is compiled once.
+    const string text("the quick brown fox jumps over the lazy dog");
+    for (int round = 0; round < 3; ++round) {
+        assert(cached_search(text, "quick"));
+        assert(not cached_search(text, "bamboozled"));
+        assert(cached_match(text, "the quick brown.*dog"));
+        assert(cached_replace(text, "dog", "cat") == "the quick brown fox jumps over the lazy cat");
+        assert(not cached_search(text, "QUICK"));
+        assert(cached_search(text, "QUICK", regex_constants::icase));
+    }
+
+    const string uri("mailto:ralf.holly@approxion.com");
+    smatch match_results;
+    assert(cached_search(uri, match_results, R"(mailto:(\S+)@(\S+))"));
+    assert(match_results[1] == "ralf.holly");
+    assert(match_results[2] == "approxion.com");
+
+    // Doesn't compile:
+    // cached_search(string(uri), match_results, R"(mailto:(\S+)@(\S+))");
+}
+
+
+void test_cache_keys_and_eviction() {
+    regex_cache cache{2};
+
+    auto dog = cache.get("dog");
+    assert(cache.get("dog") == dog);            // Hit: same compiled object.
+    assert(cache.get("dog", regex_constants::icase) != dog);   // Flags are part of the key.
+    assert(cache.hits() == 1);
+    assert(cache.misses() == 2);
+    assert(cache.size() == 2);
+
+    // "dog" is least recently used and gets evicted...
+    auto cat = cache.get("cat");
+    assert(cache.size() == 2);
+    assert(cache.get("dog") != dog);
+    // ...but our copy is still usable.
+    assert(regex_search(string("hot dog"), *dog));
+    assert(regex_search(string("tom cat"), *cat));
+}
+
+
+void test_cache_threads() {
+    regex_cache cache{4};
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, t] {
+            const char* patterns[] = { R"(\d+)", "fox", "dog", R"(\S+@\S+)", "lazy" };
+            for (int i = 0; i < 500; ++i) {
+                auto re = cache.get(patterns[(i + t) % 5]);
+                regex_search(string("the quick brown fox 42 jumps over the lazy dog"), *re);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(cache.size() == 4);
+    assert(cache.hits() + cache.misses() == 4 * 500);
+}
+
+
+void test_invalid_pattern() {
+    regex_cache cache;
+    try {
+        cache.get("(unbalanced");
+        assert(false);
+    } catch (const regex_error&) {
+    }
+    // Failed compilations are not cached.
+    assert(cache.size() == 0);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: repeated ad-hoc pattern use, fresh
+// 'regex' temporaries vs. cached helpers.
+// Run with 'make bench'.
+//
+template<typename F>
+static double us_per_round(size_t rounds, F f) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        f();
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+
+void bench_regex_cache() {
+    const string text("the quick brown fox jumps over the lazy dog");
+    const size_t rounds = 20000;
+    size_t found = 0;
+
+    double uncached = us_per_round(rounds, [&] {
+        found += regex_search(text, regex("quick"));
+        found += regex_search(text, regex("bamboozled"));
+        found += regex_match(text, regex("the quick brown.*dog"));
+        found += regex_replace(text, regex("dog"), "cat").size();
+        found += regex_search(text, regex("QUICK", regex_constants::icase));
+    });
+    double cached = us_per_round(rounds, [&] {
+        found += cached_search(text, "quick");
+        found += cached_search(text, "bamboozled");
+        found += cached_match(text, "the quick brown.*dog");
+        found += cached_replace(text, "dog", "cat").size();
+        found += cached_search(text, "QUICK", regex_constants::icase);
+    });
+    const regex quick("quick"), bamboozled("bamboozled"), full("the quick brown.*dog"),
+                dog("dog"), quick_icase("QUICK", regex_constants::icase);
+    double precompiled = us_per_round(rounds, [&] {
+        found += regex_search(text, quick);
+        found += regex_search(text, bamboozled);
+        found += regex_match(text, full);
+        found += regex_replace(text, dog, "cat").size();
+        found += regex_search(text, quick_icase);
+    });
+
+    cout << "test_regex_essential workload, us per round (5 operations)" << endl;
+    cout << fixed << setprecision(2)
+         << setw(14) << "fresh regex" << setw(14) << "cached" << setw(14) << "precompiled" << endl
+         << setw(14) << uncached << setw(14) << cached << setw(14) << precompiled << endl;
+    cout << "speedup: " << uncached / cached << "x (" << found << ")" << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_cached_helpers();
+    test_cache_keys_and_eviction();
+    test_cache_threads();
+    test_invalid_pattern();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_regex_cache();
+    }
+
+    return 0;
+}
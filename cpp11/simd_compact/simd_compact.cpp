@@ -0,0 +1,583 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <random>
+#include <vector>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'copy_if(v.begin(), v.end(), back_inserter(out),
+// pred)' branches on every element. When the
+// predicate is true for some random half of them,
+// the CPU mispredicts a quarter to half of those
+// branches, which costs more than the copying.
+//
+// 'simd::copy_if' compacts 32- and 64-bit integers
+// without branches, 4 or 8 at a time ("left-pack"):
+//
+// 1. Compare a whole vector against the value,
+//    giving one bit per lane: say 0b0101.
+// 2. Look up the shuffle for that mask in a table:
+//    it moves lanes 0 and 2 to the front.
+// 3. Store the whole shuffled vector at 'out' and
+//    advance 'out' by the number of set bits (2).
+//    The lanes behind them are overwritten by the
+//    next store.
+//
+// AVX2 (8 x 32 or 4 x 64 bits) is used if the CPU
+// has it; otherwise SSSE3 for 32 bits (it has the
+// byte shuffle that SSE2 lacks). Everything else
+// runs a branch-free scalar loop that writes every
+// element and advances 'out' only for matches.
+//
+// As both always store whole vectors, 'out' must
+// have room for 'last - first' elements, like the
+// output of 'std::copy'; 'out == first' compacts in
+// place. The predicates are comparisons with a
+// value, written 'simd::element < 100'; any other
+// predicate goes to 'std::copy_if'.
+//
+// 'simd::iota' fills 4 or 8 lanes per store with
+// SSE2 or AVX2.
+//
+namespace simd {
+
+enum class compare_op { lt, le, eq, ne, gt, ge };
+
+
+template<typename T>
+struct compare {
+    compare_op op;
+    T value;
+
+    bool operator()(T x) const {
+        switch (op) {
+        case compare_op::lt: return x < value;
+        case compare_op::le: return x <= value;
+        case compare_op::eq: return x == value;
+        case compare_op::ne: return x != value;
+        case compare_op::gt: return x > value;
+        case compare_op::ge: return x >= value;
+        }
+        return false;
+    }
+};
+
+
+// Placeholder for the element in 'element < 100' and friends.
+struct element_t { };
+constexpr element_t element{};
+
+template<typename T> compare<T> operator<(element_t, T value) { return compare<T>{compare_op::lt, value}; }
+template<typename T> compare<T> operator<=(element_t, T value) { return compare<T>{compare_op::le, value}; }
+template<typename T> compare<T> operator==(element_t, T value) { return compare<T>{compare_op::eq, value}; }
+template<typename T> compare<T> operator!=(element_t, T value) { return compare<T>{compare_op::ne, value}; }
+template<typename T> compare<T> operator>(element_t, T value) { return compare<T>{compare_op::gt, value}; }
+template<typename T> compare<T> operator>=(element_t, T value) { return compare<T>{compare_op::ge, value}; }
+
+
+namespace detail {
+
+inline bool cpu_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+inline bool cpu_has_ssse3() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+#else
+    return false;
+#endif
+}
+
+
+// Branch-free scalar version, also used for the tails of the vectorized ones.
+template<typename T>
+T* copy_if_scalar(const T* first, const T* last, T* out, compare<T> pred) {
+    for (; first != last; ++first) {
+        T x = *first;
+        *out = x;
+        out += pred(x);
+    }
+    return out;
+}
+
+template<typename T>
+void iota_scalar(T* first, T* last, T value) {
+    std::iota(first, last, value);
+}
+
+
+#if defined(__SSE2__)
+// 'le', 'ne' and 'ge' are the negations of 'gt', 'eq' and 'lt'.
+inline bool negated(compare_op op) {
+    return op == compare_op::le || op == compare_op::ne || op == compare_op::ge;
+}
+
+
+// Left-pack shuffles, indexed by the comparison mask.
+struct pack_tables {
+    uint64_t avx2_32[256];          // 8 lane indices for '_mm256_permutevar8x32_epi32', one per byte.
+    uint64_t avx2_64[16];           // The same, two 32-bit lanes per 64-bit lane.
+    uint8_t ssse3_32[16][16];       // Byte indices for '_mm_shuffle_epi8'.
+    uint8_t counts[256];            // Set bits per mask; SSSE3 CPUs may lack 'popcnt'.
+
+    pack_tables() {
+        memset(this, 0, sizeof(*this));
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            counts[mask] = static_cast<uint8_t>(__builtin_popcount(mask));
+            unsigned out = 0;
+            for (unsigned lane = 0; lane < 8; ++lane) {
+                if (mask & (1u << lane)) {
+                    avx2_32[mask] |= static_cast<uint64_t>(lane) << (8 * out++);
+                }
+            }
+        }
+        for (unsigned mask = 0; mask < 16; ++mask) {
+            unsigned out = 0;
+            for (unsigned lane = 0; lane < 4; ++lane) {
+                if (mask & (1u << lane)) {
+                    avx2_64[mask] |= static_cast<uint64_t>(2 * lane) << (16 * out)
+                                   | static_cast<uint64_t>(2 * lane + 1) << (16 * out + 8);
+                    for (unsigned byte = 0; byte < 4; ++byte) {
+                        ssse3_32[mask][4 * out + byte] = static_cast<uint8_t>(4 * lane + byte);
+                    }
+                    ++out;
+                }
+            }
+        }
+    }
+};
+
+inline const pack_tables& tables() {
+    static const pack_tables instance;
+    return instance;
+}
+
+
+template<compare_op Op>
+__attribute__((target("ssse3")))
+int32_t* copy_if_ssse3(const int32_t* first, const int32_t* last, int32_t* out, int32_t value) {
+    const pack_tables& t = tables();
+    const __m128i v = _mm_set1_epi32(value);
+    const int32_t* p = first;
+    for (; last - p >= 4; p += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m;
+        switch (Op) {
+        case compare_op::lt: case compare_op::ge: m = _mm_cmplt_epi32(x, v); break;
+        case compare_op::gt: case compare_op::le: m = _mm_cmpgt_epi32(x, v); break;
+        default: m = _mm_cmpeq_epi32(x, v); break;
+        }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m))) ^ (negated(Op) ? 0xF : 0);
+        __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.ssse3_32[mask]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(x, shuffle));
+        out += t.counts[mask];
+    }
+    return copy_if_scalar(p, last, out, compare<int32_t>{Op, value});
+}
+
+
+template<compare_op Op>
+__attribute__((target("avx2")))
+int32_t* copy_if_avx2(const int32_t* first, const int32_t* last, int32_t* out, int32_t value) {
+    const pack_tables& t = tables();
+    const __m256i v = _mm256_set1_epi32(value);
+    const int32_t* p = first;
+    for (; last - p >= 8; p += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m;
+        switch (Op) {
+        case compare_op::lt: case compare_op::ge: m = _mm256_cmpgt_epi32(v, x); break;
+        case compare_op::gt: case compare_op::le: m = _mm256_cmpgt_epi32(x, v); break;
+        default: m = _mm256_cmpeq_epi32(x, v); break;
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m))) ^ (negated(Op) ? 0xFF : 0);
+        __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&t.avx2_32[mask])));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permutevar8x32_epi32(x, permutation));
+        out += t.counts[mask];
+    }
+    return copy_if_scalar(p, last, out, compare<int32_t>{Op, value});
+}
+
+
+template<compare_op Op>
+__attribute__((target("avx2")))
+int64_t* copy_if_avx2(const int64_t* first, const int64_t* last, int64_t* out, int64_t value) {
+    const pack_tables& t = tables();
+    const __m256i v = _mm256_set1_epi64x(value);
+    const int64_t* p = first;
+    for (; last - p >= 4; p += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m;
+        switch (Op) {
+        case compare_op::lt: case compare_op::ge: m = _mm256_cmpgt_epi64(v, x); break;
+        case compare_op::gt: case compare_op::le: m = _mm256_cmpgt_epi64(x, v); break;
+        default: m = _mm256_cmpeq_epi64(x, v); break;
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m))) ^ (negated(Op) ? 0xF : 0);
+        __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&t.avx2_64[mask])));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permutevar8x32_epi32(x, permutation));
+        out += t.counts[mask];
+    }
+    return copy_if_scalar(p, last, out, compare<int64_t>{Op, value});
+}
+
+
+// The comparison is a template argument of the kernels, so it isn't decided
+// anew in each iteration.
+#define SIMD_COMPACT_DISPATCH(kernel, pred, ...)                                    \
+    switch (pred.op) {                                                              \
+    case compare_op::lt: return kernel<compare_op::lt>(__VA_ARGS__, pred.value);    \
+    case compare_op::le: return kernel<compare_op::le>(__VA_ARGS__, pred.value);    \
+    case compare_op::eq: return kernel<compare_op::eq>(__VA_ARGS__, pred.value);    \
+    case compare_op::ne: return kernel<compare_op::ne>(__VA_ARGS__, pred.value);    \
+    case compare_op::gt: return kernel<compare_op::gt>(__VA_ARGS__, pred.value);    \
+    case compare_op::ge: return kernel<compare_op::ge>(__VA_ARGS__, pred.value);    \
+    }                                                                               \
+    return out;
+
+inline int32_t* copy_if_ssse3(const int32_t* first, const int32_t* last, int32_t* out, compare<int32_t> pred) {
+    SIMD_COMPACT_DISPATCH(copy_if_ssse3, pred, first, last, out)
+}
+
+inline int32_t* copy_if_avx2(const int32_t* first, const int32_t* last, int32_t* out, compare<int32_t> pred) {
+    SIMD_COMPACT_DISPATCH(copy_if_avx2, pred, first, last, out)
+}
+
+inline int64_t* copy_if_avx2(const int64_t* first, const int64_t* last, int64_t* out, compare<int64_t> pred) {
+    SIMD_COMPACT_DISPATCH(copy_if_avx2, pred, first, last, out)
+}
+
+#undef SIMD_COMPACT_DISPATCH
+
+
+inline void iota_sse2(int32_t* first, int32_t* last, int32_t value) {
+    __m128i x = _mm_setr_epi32(value, value + 1, value + 2, value + 3);
+    const __m128i step = _mm_set1_epi32(4);
+    int32_t* p = first;
+    for (; last - p >= 4; p += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+        x = _mm_add_epi32(x, step);
+    }
+    iota_scalar(p, last, static_cast<int32_t>(value + (p - first)));
+}
+
+inline void iota_sse2(int64_t* first, int64_t* last, int64_t value) {
+    __m128i x = _mm_set_epi64x(value + 1, value);
+    const __m128i step = _mm_set1_epi64x(2);
+    int64_t* p = first;
+    for (; last - p >= 2; p += 2) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+        x = _mm_add_epi64(x, step);
+    }
+    iota_scalar(p, last, value + (p - first));
+}
+
+__attribute__((target("avx2")))
+inline void iota_avx2(int32_t* first, int32_t* last, int32_t value) {
+    __m256i x = _mm256_add_epi32(_mm256_set1_epi32(value), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8);
+    int32_t* p = first;
+    for (; last - p >= 8; p += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+        x = _mm256_add_epi32(x, step);
+    }
+    iota_sse2(p, last, static_cast<int32_t>(value + (p - first)));
+}
+
+__attribute__((target("avx2")))
+inline void iota_avx2(int64_t* first, int64_t* last, int64_t value) {
+    __m256i x = _mm256_add_epi64(_mm256_set1_epi64x(value), _mm256_setr_epi64x(0, 1, 2, 3));
+    const __m256i step = _mm256_set1_epi64x(4);
+    int64_t* p = first;
+    for (; last - p >= 4; p += 4) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+        x = _mm256_add_epi64(x, step);
+    }
+    iota_sse2(p, last, value + (p - first));
+}
+#endif
+
+}   // namespace detail
+
+
+// Copies the elements of [first, last) that match 'pred' to 'out', which must
+// have room for 'last - first' elements. Returns the end of the copied ones.
+inline int32_t* copy_if(const int32_t* first, const int32_t* last, int32_t* out, compare<int32_t> pred) {
+#if defined(__SSE2__)
+    if (detail::cpu_has_avx2()) {
+        return detail::copy_if_avx2(first, last, out, pred);
+    }
+    if (detail::cpu_has_ssse3()) {
+        return detail::copy_if_ssse3(first, last, out, pred);
+    }
+#endif
+    return detail::copy_if_scalar(first, last, out, pred);
+}
+
+inline int64_t* copy_if(const int64_t* first, const int64_t* last, int64_t* out, compare<int64_t> pred) {
+#if defined(__SSE2__)
+    if (detail::cpu_has_avx2()) {
+        return detail::copy_if_avx2(first, last, out, pred);
+    }
+#endif
+    return detail::copy_if_scalar(first, last, out, pred);
+}
+
+// Any other predicate or element type. Not for the comparisons above: with
+// 'int32_t*' rather than 'const int32_t*' arguments, this would be the better match.
+template<typename InIt, typename OutIt, typename Pred,
+         typename = typename enable_if<!is_same<Pred, compare<int32_t>>::value &&
+                                       !is_same<Pred, compare<int64_t>>::value>::type>
+OutIt copy_if(InIt first, InIt last, OutIt out, Pred pred) {
+    return std::copy_if(first, last, out, pred);
+}
+
+
+template<typename T>
+void iota(T* first, T* last, T value) {
+#if defined(__SSE2__)
+    if (detail::cpu_has_avx2()) {
+        return detail::iota_avx2(first, last, value);
+    }
+    return detail::iota_sse2(first, last, value);
+#else
+    return detail::iota_scalar(first, last, value);
+#endif
+}
+
+}   // namespace simd
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_simd_compact_primes() {
+    // The examples from the 'odds_and_ends' chapter.
+    const vector<int32_t> primes{2, 3, 5, 7, 11, 13, 17, 19};
+    vector<int32_t> small_primes(primes.size());
+    int32_t* end = simd::copy_if(primes.data(), primes.data() + primes.size(), small_primes.data(), simd::element < 10);
+    small_primes.resize(end - small_primes.data());
+    assert((small_primes == vector<int32_t>{2, 3, 5, 7}));
+
+    // Other predicates go to 'std::copy_if'.
+    vector<int32_t> even_primes;
+    simd::copy_if(primes.begin(), primes.end(), back_inserter(even_primes), [](int32_t v) { return (v % 2) == 0; });
+    assert(even_primes.size() == 1 && even_primes.front() == 2);
+
+    vector<int32_t> hundred_plus(5);
+    simd::iota(hundred_plus.data(), hundred_plus.data() + hundred_plus.size(), 100);
+    assert(hundred_plus[0] == 100);
+    assert(hundred_plus[4] == 104);
+
+    // Non-const input pointers take the vectorized path, too; unlike 'std::copy_if',
+    // it writes behind the copied elements.
+    vector<int32_t> none(8, 1000);
+    vector<int32_t> out(8, -1);
+    assert(simd::copy_if(none.data(), none.data() + 8, out.data(), simd::element < 10) == out.data());
+    assert(out[0] == 1000);
+
+    // In place.
+    vector<int64_t> big{ INT64_MIN, 5, INT64_MAX, -3, 0, 1LL << 40 };
+    big.resize(simd::copy_if(big.data(), big.data() + big.size(), big.data(), simd::element >= int64_t(0)) - big.data());
+    assert((big == vector<int64_t>{5, INT64_MAX, 0, 1LL << 40}));
+}
+
+
+template<typename T>
+void check_all_kernels(const vector<T>& v, simd::compare<T> pred) {
+    vector<T> expected;
+    std::copy_if(v.begin(), v.end(), back_inserter(expected), pred);
+
+    auto check = [&](T* (*kernel)(const T*, const T*, T*, simd::compare<T>)) {
+        vector<T> out(v.size() + 1, T(-77));
+        T* end = kernel(v.data(), v.data() + v.size(), out.data(), pred);
+        assert(static_cast<size_t>(end - out.data()) == expected.size());
+        assert(equal(expected.begin(), expected.end(), out.data()));
+        assert(out[v.size()] == T(-77));    // Nothing written past 'last - first' elements.
+    };
+    check(&simd::detail::copy_if_scalar<T>);
+    check(static_cast<T* (*)(const T*, const T*, T*, simd::compare<T>)>(&simd::copy_if));
+}
+
+
+void test_simd_compact_matches_scalar() {
+    mt19937 rng(7);
+    uniform_int_distribution<int> values(-3, 3);
+    const simd::compare_op ops[] = { simd::compare_op::lt, simd::compare_op::le, simd::compare_op::eq,
+                                     simd::compare_op::ne, simd::compare_op::gt, simd::compare_op::ge };
+    for (size_t n = 0; n < 40; ++n) {
+        vector<int32_t> v32(n);
+        vector<int64_t> v64(n);
+        for (int round = 0; round < 10; ++round) {
+            for (size_t i = 0; i < n; ++i) {
+                v32[i] = values(rng);
+                v64[i] = values(rng) * (int64_t{1} << 33);
+            }
+            if (n > 1 && round == 0) {
+                v32[0] = INT32_MIN;
+                v32[n - 1] = INT32_MAX;
+                v64[0] = INT64_MIN;
+                v64[n - 1] = INT64_MAX;
+            }
+            for (simd::compare_op op : ops) {
+                for (int value : { -1, 0, 2 }) {
+                    check_all_kernels(v32, simd::compare<int32_t>{op, value});
+                    check_all_kernels(v64, simd::compare<int64_t>{op, value * (int64_t{1} << 33)});
+                }
+            }
+        }
+    }
+
+#if defined(__SSE2__)
+    // The kernels that weren't picked above.
+    vector<int32_t> v(1000);
+    for (auto& x : v) {
+        x = values(rng);
+    }
+    simd::compare<int32_t> pred = simd::element > 0;
+    vector<int32_t> expected;
+    std::copy_if(v.begin(), v.end(), back_inserter(expected), pred);
+    vector<int32_t> out(v.size());
+    if (simd::detail::cpu_has_ssse3()) {
+        out.resize(simd::detail::copy_if_ssse3(v.data(), v.data() + v.size(), out.data(), pred) - out.data());
+        assert(out == expected);
+    }
+#endif
+}
+
+
+template<typename T>
+void check_iota(size_t n, T value) {
+    vector<T> expected(n);
+    std::iota(expected.begin(), expected.end(), value);
+    vector<T> v(n);
+    simd::iota(v.data(), v.data() + n, value);
+    assert(v == expected);
+#if defined(__SSE2__)
+    fill(v.begin(), v.end(), T(0));
+    simd::detail::iota_sse2(v.data(), v.data() + n, value);
+    assert(v == expected);
+    if (simd::detail::cpu_has_avx2()) {
+        fill(v.begin(), v.end(), T(0));
+        simd::detail::iota_avx2(v.data(), v.data() + n, value);
+        assert(v == expected);
+    }
+#endif
+}
+
+
+void test_simd_iota() {
+    for (size_t n = 0; n < 40; ++n) {
+        check_iota<int32_t>(n, -5);
+        check_iota<int64_t>(n, (1LL << 40) - 7);
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: M elements per second for 'copy_if'
+// with 'back_inserter' (the vector keeps its
+// capacity between rounds), the branch-free scalar
+// loop and 'simd::copy_if', at selectivities from
+// 1% to 99%, plus 'iota'.
+// Run with 'make bench'.
+//
+template<typename F>
+static double m_per_second(size_t n, size_t rounds, F f) {
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        f();
+        asm volatile("" : : : "memory");
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    return n * rounds / elapsed.count();
+}
+
+
+template<typename T>
+void bench_type(const char* name, size_t n, size_t rounds) {
+    vector<T> v(n);
+    mt19937 rng(1);
+    uniform_int_distribution<int> values(0, 9999);
+    for (auto& x : v) {
+        x = static_cast<T>(values(rng));
+    }
+    vector<T> pushed;
+    pushed.reserve(n);
+    vector<T> out(n);
+
+    cout << name << ", M elements/s" << endl;
+    cout << setw(12) << "selectivity" << setw(24) << "copy_if back_inserter" << setw(16) << "branch-free"
+         << setw(16) << "simd::copy_if" << endl;
+    for (int percent : { 1, 10, 25, 50, 75, 90, 99 }) {
+        simd::compare<T> pred = simd::element < static_cast<T>(percent * 100);
+        auto lambda = [percent](T x) { return x < static_cast<T>(percent * 100); };
+        size_t c1 = 0, c2 = 0, c3 = 0;
+        double t_std = m_per_second(n, rounds, [&] {
+            pushed.clear();
+            std::copy_if(v.begin(), v.end(), back_inserter(pushed), lambda);
+            c1 += pushed.size();
+        });
+        double t_scalar = m_per_second(n, rounds, [&] {
+            c2 += simd::detail::copy_if_scalar(v.data(), v.data() + n, out.data(), pred) - out.data();
+        });
+        double t_simd = m_per_second(n, rounds, [&] {
+            c3 += simd::copy_if(v.data(), v.data() + n, out.data(), pred) - out.data();
+        });
+        assert(c1 == c2 && c2 == c3);
+        cout << fixed << setprecision(0) << setw(11) << percent << "%" << setw(24) << t_std
+             << setw(16) << t_scalar << setw(16) << t_simd << endl;
+    }
+
+    double t_std_iota = m_per_second(n, rounds, [&] { std::iota(out.begin(), out.end(), T(0)); });
+    double t_simd_iota = m_per_second(n, rounds, [&] { simd::iota(out.data(), out.data() + n, T(0)); });
+    assert(out[n - 1] == static_cast<T>(n - 1));
+    cout << setw(12) << "iota" << setw(24) << t_std_iota << setw(16) << "-" << setw(16) << t_simd_iota << endl;
+}
+
+
+void bench_simd_compact() {
+    const size_t n = 10000000;
+    const size_t rounds = 10;
+    cout << n << " elements, values uniform in [0, 10000), " << (simd::detail::cpu_has_avx2() ? "AVX2" : "SSSE3/scalar")
+         << " used" << endl;
+    bench_type<int32_t>("int32_t", n, rounds);
+    bench_type<int64_t>("int64_t", n, rounds);
+}
+
+
+int main(int argc, char* argv[]) {
+    test_simd_compact_primes();
+    test_simd_compact_matches_scalar();
+    test_simd_iota();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_simd_compact();
+    }
+
+    return 0;
+}
@@ -0,0 +1,462 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'find_if(scores.begin(), scores.end(),
+//          [](int score) { return score < 0; })'
+// checks one element per iteration and branches on
+// each. Compilers don't vectorize loops that can
+// exit early, so that's what runs.
+//
+// A lambda is opaque: nothing can look inside it to
+// see that it's a simple comparison. So the
+// comparisons that can be vectorized get a type of
+// their own, 'int_predicate', which is still a
+// callable and reads like the lambda it replaces:
+//
+//     simd::find_if(first, last, simd::element < 0);
+//
+// 'simd::find_if' and 'simd::count_if' compare 4
+// (SSE2) or 8 (AVX2) ints at once and turn the
+// comparison result into a bit mask; the first set
+// bit is the match. AVX2 is chosen at run-time if
+// the CPU has it. Any other predicate, e.g. a
+// lambda, is passed on to 'std::find_if' and
+// 'std::count_if'.
+//
+namespace simd {
+
+enum class compare_op { lt, le, eq, ne, gt, ge };
+
+
+struct int_predicate {
+    compare_op op;
+    int value;
+
+    bool operator()(int x) const {
+        switch (op) {
+        case compare_op::lt: return x < value;
+        case compare_op::le: return x <= value;
+        case compare_op::eq: return x == value;
+        case compare_op::ne: return x != value;
+        case compare_op::gt: return x > value;
+        case compare_op::ge: return x >= value;
+        }
+        return false;
+    }
+};
+
+
+// Placeholder for the element in 'element < 0' and friends.
+struct element_t { };
+constexpr element_t element{};
+
+inline int_predicate operator<(element_t, int value) { return int_predicate{compare_op::lt, value}; }
+inline int_predicate operator<=(element_t, int value) { return int_predicate{compare_op::le, value}; }
+inline int_predicate operator==(element_t, int value) { return int_predicate{compare_op::eq, value}; }
+inline int_predicate operator!=(element_t, int value) { return int_predicate{compare_op::ne, value}; }
+inline int_predicate operator>(element_t, int value) { return int_predicate{compare_op::gt, value}; }
+inline int_predicate operator>=(element_t, int value) { return int_predicate{compare_op::ge, value}; }
+
+
+namespace detail {
+
+inline bool cpu_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+
+// Scalar versions, also used for the tails of the vectorized ones.
+inline const int* find_if_scalar(const int* first, const int* last, int_predicate pred) {
+    return std::find_if(first, last, pred);
+}
+
+inline size_t count_if_scalar(const int* first, const int* last, int_predicate pred) {
+    return static_cast<size_t>(std::count_if(first, last, pred));
+}
+
+
+#if defined(__SSE2__)
+// One bit per int: bit i is set if element i matches.
+template<compare_op Op>
+inline unsigned match_mask_sse2(__m128i x, __m128i value) {
+    __m128i m;
+    switch (Op) {
+    case compare_op::lt: case compare_op::ge: m = _mm_cmplt_epi32(x, value); break;
+    case compare_op::gt: case compare_op::le: m = _mm_cmpgt_epi32(x, value); break;
+    default: m = _mm_cmpeq_epi32(x, value); break;
+    }
+    unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+    // 'le', 'ne' and 'ge' are the negations of 'gt', 'eq' and 'lt'.
+    bool negate = Op == compare_op::le || Op == compare_op::ne || Op == compare_op::ge;
+    return negate ? mask ^ 0xF : mask;
+}
+
+
+template<compare_op Op>
+const int* find_if_sse2(const int* first, const int* last, int value) {
+    const __m128i v = _mm_set1_epi32(value);
+    const int* p = first;
+    // Four vectors per iteration; one branch for all of them.
+    for (; last - p >= 16; p += 16) {
+        unsigned mask = match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), v)
+                      | match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4)), v) << 4
+                      | match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8)), v) << 8
+                      | match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), v) << 12;
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    for (; last - p >= 4; p += 4) {
+        unsigned mask = match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), v);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_if_scalar(p, last, int_predicate{Op, value});
+}
+
+
+template<compare_op Op>
+size_t count_if_sse2(const int* first, const int* last, int value) {
+    const __m128i v = _mm_set1_epi32(value);
+    const int* p = first;
+    size_t count = 0;
+    for (; last - p >= 4; p += 4) {
+        count += __builtin_popcount(match_mask_sse2<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), v));
+    }
+    return count + count_if_scalar(p, last, int_predicate{Op, value});
+}
+
+
+template<compare_op Op>
+__attribute__((target("avx2")))
+inline unsigned match_mask_avx2(__m256i x, __m256i value) {
+    __m256i m;
+    switch (Op) {
+    case compare_op::lt: case compare_op::ge: m = _mm256_cmpgt_epi32(value, x); break;
+    case compare_op::gt: case compare_op::le: m = _mm256_cmpgt_epi32(x, value); break;
+    default: m = _mm256_cmpeq_epi32(x, value); break;
+    }
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    bool negate = Op == compare_op::le || Op == compare_op::ne || Op == compare_op::ge;
+    return negate ? mask ^ 0xFF : mask;
+}
+
+
+template<compare_op Op>
+__attribute__((target("avx2")))
+const int* find_if_avx2(const int* first, const int* last, int value) {
+    const __m256i v = _mm256_set1_epi32(value);
+    const int* p = first;
+    // Two vectors per iteration; one branch for both.
+    for (; last - p >= 16; p += 16) {
+        unsigned mask = match_mask_avx2<Op>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), v)
+                      | match_mask_avx2<Op>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8)), v) << 8;
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    for (; last - p >= 8; p += 8) {
+        unsigned mask = match_mask_avx2<Op>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), v);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_if_sse2<Op>(p, last, value);
+}
+
+
+template<compare_op Op>
+__attribute__((target("avx2")))
+size_t count_if_avx2(const int* first, const int* last, int value) {
+    const __m256i v = _mm256_set1_epi32(value);
+    const int* p = first;
+    size_t count = 0;
+    while (last - p >= 8) {
+        // Matches are -1 per lane, so subtracting them counts per lane. Lanes
+        // are summed up before they could overflow.
+        __m256i counts = _mm256_setzero_si256();
+        const int* start = p;
+        const int* end = p + min<ptrdiff_t>((last - p) / 8, 1 << 28) * 8;
+        for (; p != end; p += 8) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i m;
+            switch (Op) {
+            case compare_op::lt: case compare_op::ge: m = _mm256_cmpgt_epi32(v, x); break;
+            case compare_op::gt: case compare_op::le: m = _mm256_cmpgt_epi32(x, v); break;
+            default: m = _mm256_cmpeq_epi32(x, v); break;
+            }
+            counts = _mm256_sub_epi32(counts, m);
+        }
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), counts);
+        size_t matches = 0;
+        for (uint32_t lane : lanes) {
+            matches += lane;
+        }
+        bool negate = Op == compare_op::le || Op == compare_op::ne || Op == compare_op::ge;
+        count += negate ? static_cast<size_t>(end - start) - matches : matches;
+    }
+    return count + count_if_sse2<Op>(p, last, value);
+}
+
+#define SIMD_FIND_DISPATCH(kernel, op, ...)                                         \
+    switch (op) {                                                                   \
+    case compare_op::lt: return kernel<compare_op::lt>(__VA_ARGS__);                \
+    case compare_op::le: return kernel<compare_op::le>(__VA_ARGS__);                \
+    case compare_op::eq: return kernel<compare_op::eq>(__VA_ARGS__);                \
+    case compare_op::ne: return kernel<compare_op::ne>(__VA_ARGS__);                \
+    case compare_op::gt: return kernel<compare_op::gt>(__VA_ARGS__);                \
+    case compare_op::ge: return kernel<compare_op::ge>(__VA_ARGS__);                \
+    }
+
+// Versions with the comparison as a run-time argument, for the tests.
+inline const int* find_if_sse2(const int* first, const int* last, int_predicate pred) {
+    SIMD_FIND_DISPATCH(find_if_sse2, pred.op, first, last, pred.value)
+    return last;
+}
+
+inline size_t count_if_sse2(const int* first, const int* last, int_predicate pred) {
+    SIMD_FIND_DISPATCH(count_if_sse2, pred.op, first, last, pred.value)
+    return 0;
+}
+
+inline const int* find_if_avx2(const int* first, const int* last, int_predicate pred) {
+    SIMD_FIND_DISPATCH(find_if_avx2, pred.op, first, last, pred.value)
+    return last;
+}
+
+inline size_t count_if_avx2(const int* first, const int* last, int_predicate pred) {
+    SIMD_FIND_DISPATCH(count_if_avx2, pred.op, first, last, pred.value)
+    return 0;
+}
+
+#undef SIMD_FIND_DISPATCH
+#endif
+
+}   // namespace detail
+
+
+// Returns the first element in [first, last) that matches 'pred', or 'last'.
+inline const int* find_if(const int* first, const int* last, int_predicate pred) {
+#if defined(__SSE2__)
+    if (detail::cpu_has_avx2()) {
+        return detail::find_if_avx2(first, last, pred);
+    }
+    return detail::find_if_sse2(first, last, pred);
+#else
+    return detail::find_if_scalar(first, last, pred);
+#endif
+}
+
+inline size_t count_if(const int* first, const int* last, int_predicate pred) {
+#if defined(__SSE2__)
+    if (detail::cpu_has_avx2()) {
+        return detail::count_if_avx2(first, last, pred);
+    }
+    return detail::count_if_sse2(first, last, pred);
+#else
+    return detail::count_if_scalar(first, last, pred);
+#endif
+}
+
+// Any other predicate can't be looked into.
+template<typename Pred>
+const int* find_if(const int* first, const int* last, Pred pred) {
+    return std::find_if(first, last, pred);
+}
+
+template<typename Pred>
+size_t count_if(const int* first, const int* last, Pred pred) {
+    return static_cast<size_t>(std::count_if(first, last, pred));
+}
+
+inline const int* find_first_lt(const int* first, const int* last, int value) {
+    return find_if(first, last, element < value);
+}
+
+inline const int* find_first_eq(const int* first, const int* last, int value) {
+    return find_if(first, last, element == value);
+}
+
+inline size_t count_lt(const int* first, const int* last, int value) {
+    return count_if(first, last, element < value);
+}
+
+inline size_t count_eq(const int* first, const int* last, int value) {
+    return count_if(first, last, element == value);
+}
+
+}   // namespace simd
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_simd_find_scores() {
+    // The example from the 'lambda_expressions' chapter.
+    vector<int> scores { 101, 190, -2, 22, 39 };
+    const int* first = scores.data();
+    const int* last = first + scores.size();
+
+    const int* target = simd::find_if(first, last, simd::element < 0);
+    assert(*target == -2);
+    assert(simd::find_first_lt(first, last, 0) == target);
+    assert(simd::find_first_eq(first, last, 22) == first + 3);
+    assert(simd::find_first_eq(first, last, 23) == last);
+    assert(simd::count_if(first, last, simd::element >= 39) == 3);
+
+    // Predicates are callables, too.
+    assert(std::find_if(scores.begin(), scores.end(), simd::element < 0) - scores.begin() == 2);
+
+    // Lambdas still work, via 'std::find_if'.
+    assert(simd::find_if(first, last, [](int score) { return score < 0; }) == target);
+    assert(simd::count_if(first, last, [](int score) { return score % 2 == 0; }) == 3);
+}
+
+
+void test_simd_find_matches_scalar() {
+    mt19937 rng(42);
+    uniform_int_distribution<int> values(-4, 4);
+    const simd::compare_op ops[] = { simd::compare_op::lt, simd::compare_op::le, simd::compare_op::eq,
+                                     simd::compare_op::ne, simd::compare_op::gt, simd::compare_op::ge };
+    bool has_avx2 = simd::detail::cpu_has_avx2();
+
+    // All lengths around the vector widths, every match position, extreme values.
+    for (size_t n = 0; n < 70; ++n) {
+        vector<int> v(n);
+        for (int round = 0; round < 20; ++round) {
+            for (auto& x : v) {
+                x = values(rng);
+            }
+            if (n > 0 && round == 0) {
+                v[0] = INT32_MIN;
+                v[n - 1] = INT32_MAX;
+            }
+            const int* first = v.data();
+            const int* last = first + n;
+            for (simd::compare_op op : ops) {
+                for (int value : { -5, -1, 0, 3, INT32_MIN, INT32_MAX }) {
+                    simd::int_predicate pred{op, value};
+                    const int* expected = std::find_if(first, last, pred);
+                    size_t expected_count = static_cast<size_t>(std::count_if(first, last, pred));
+                    assert(simd::detail::find_if_scalar(first, last, pred) == expected);
+                    assert(simd::find_if(first, last, pred) == expected);
+                    assert(simd::count_if(first, last, pred) == expected_count);
+#if defined(__SSE2__)
+                    assert(simd::detail::find_if_sse2(first, last, pred) == expected);
+                    assert(simd::detail::count_if_sse2(first, last, pred) == expected_count);
+                    if (has_avx2) {
+                        assert(simd::detail::find_if_avx2(first, last, pred) == expected);
+                        assert(simd::detail::count_if_avx2(first, last, pred) == expected_count);
+                    }
+#endif
+                }
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: the 'score < 0' search and count as a
+// lambda through 'std::find_if'/'std::count_if'
+// vs. 'simd::find_if'/'simd::count_if', from 1K to
+// 100M ints. The only negative score is the last
+// one, so every search scans the whole vector.
+// Run with 'make bench'.
+//
+template<typename F>
+static double ns_per_element(size_t n, F f) {
+    // Repeat small sizes so that each measurement covers ~100M elements.
+    size_t rounds = max<size_t>(1, 100000000 / n);
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        f();
+        // The data "might have changed", so the search isn't hoisted out of the loop.
+        asm volatile("" : : : "memory");
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / (n * rounds);
+}
+
+
+void bench_simd_find() {
+    cout << "ns per element, 'score < 0'; " << (simd::detail::cpu_has_avx2() ? "AVX2" : "SSE2") << " used" << endl;
+    cout << setw(12) << "elements" << setw(14) << "std::find_if" << setw(14) << "simd sse2"
+         << setw(14) << "simd find_if" << setw(15) << "std::count_if" << setw(15) << "simd count_if" << endl;
+
+    for (size_t n = 1000; n <= 100000000; n *= 10) {
+        vector<int> scores(n);
+        for (size_t i = 0; i < n; ++i) {
+            scores[i] = static_cast<int>(i % 1000);
+        }
+        scores[n - 1] = -2;
+        const int* first = scores.data();
+        const int* last = first + n;
+
+        size_t found = 0;
+        double t_std = ns_per_element(n, [&] {
+            found += std::find_if(first, last, [](int score) { return score < 0; }) - first;
+        });
+        double t_sse2 = ns_per_element(n, [&] {
+#if defined(__SSE2__)
+            found += simd::detail::find_if_sse2(first, last, simd::element < 0) - first;
+#else
+            found += n - 1;
+#endif
+        });
+        double t_simd = ns_per_element(n, [&] {
+            found += simd::find_if(first, last, simd::element < 0) - first;
+        });
+
+        size_t counted = 0;
+        double t_std_count = ns_per_element(n, [&] {
+            counted += std::count_if(first, last, [](int score) { return score < 0; });
+        });
+        double t_simd_count = ns_per_element(n, [&] {
+            counted += simd::count_if(first, last, simd::element < 0);
+        });
+
+        size_t rounds = max<size_t>(1, 100000000 / n);
+        assert(found == 3 * rounds * (n - 1));
+        assert(counted == 2 * rounds);
+        cout << fixed << setprecision(3) << setw(12) << n << setw(14) << t_std << setw(14) << t_sse2
+             << setw(14) << t_simd << setw(15) << t_std_count << setw(15) << t_simd_count << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_simd_find_scores();
+    test_simd_find_matches_scalar();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_simd_find();
+    }
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// A 'slot_map' stores objects in a dense array and
+// hands out handles (index + generation) instead
+// of pointers. It is a cheap replacement for
+// 'weak_ptr' when objects are owned by a single
+// container:
+//
+// - Lookup is O(1): one indirection through the slot table.
+// - Liveness checks compare generations, no atomic
+//   reference count is touched.
+// - When an object is erased, its slot's generation
+//   is bumped, so old handles become stale.
+// - Objects are kept contiguous (erase swaps the last
+//   object into the hole), so batch processing is
+//   a plain loop over an array.
+//
+struct slot_handle {
+    uint32_t index;
+    uint32_t generation;
+};
+
+
+inline bool operator==(slot_handle lhs, slot_handle rhs) {
+    return lhs.index == rhs.index && lhs.generation == rhs.generation;
+}
+
+
+template<typename T>
+class slot_map {
+public:
+    using iterator = typename vector<T>::iterator;
+    using const_iterator = typename vector<T>::const_iterator;
+
+    template<typename... Args>
+    slot_handle emplace(Args&&... args) {
+        uint32_t slot_index;
+        if (free_head_ != no_slot) {
+            slot_index = free_head_;
+            free_head_ = slots_[slot_index].target;
+        } else {
+            slot_index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(slot{0, 0});
+        }
+        values_.emplace_back(std::forward<Args>(args)...);
+        dense_to_slot_.push_back(slot_index);
+        slots_[slot_index].target = static_cast<uint32_t>(values_.size() - 1);
+        return slot_handle{slot_index, slots_[slot_index].generation};
+    }
+
+    slot_handle insert(T value) {
+        return emplace(std::move(value));
+    }
+
+    // Liveness check, the equivalent of '!weak_ptr::expired()'.
+    bool contains(slot_handle h) const {
+        return h.index < slots_.size() && slots_[h.index].generation == h.generation;
+    }
+
+    // Returns nullptr for stale handles, the equivalent of 'weak_ptr::lock()'.
+    T* get(slot_handle h) {
+        return contains(h) ? &values_[slots_[h.index].target] : nullptr;
+    }
+
+    const T* get(slot_handle h) const {
+        return contains(h) ? &values_[slots_[h.index].target] : nullptr;
+    }
+
+    bool erase(slot_handle h) {
+        if (!contains(h)) {
+            return false;
+        }
+        slot& erased = slots_[h.index];
+        uint32_t hole = erased.target;
+        uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+
+        // Move last object into the hole to keep the array dense.
+        if (hole != last) {
+            values_[hole] = std::move(values_[last]);
+            dense_to_slot_[hole] = dense_to_slot_[last];
+            slots_[dense_to_slot_[hole]].target = hole;
+        }
+        values_.pop_back();
+        dense_to_slot_.pop_back();
+
+        // Invalidate all outstanding handles and put slot on free list.
+        ++erased.generation;
+        erased.target = free_head_;
+        free_head_ = h.index;
+        return true;
+    }
+
+    size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+
+    // Dense iteration, in no particular order.
+    iterator begin() { return values_.begin(); }
+    iterator end() { return values_.end(); }
+    const_iterator begin() const { return values_.begin(); }
+    const_iterator end() const { return values_.end(); }
+    T* data() { return values_.data(); }
+
+private:
+    static const uint32_t no_slot = numeric_limits<uint32_t>::max();
+
+    struct slot {
+        uint32_t target;        // Dense index if occupied, next free slot otherwise.
+        uint32_t generation;
+    };
+
+    vector<T> values_;
+    vector<uint32_t> dense_to_slot_;
+    vector<slot> slots_;
+    uint32_t free_head_ = no_slot;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_slot_map_basic() {
+    slot_map<string> names;
+    slot_handle alice = names.insert("alice");
+    slot_handle bob = names.emplace(3, 'b');
+
+    assert(names.size() == 2);
+    assert(names.contains(alice));
+    assert(*names.get(alice) == "alice");
+    assert(*names.get(bob) == "bbb");
+
+    // Handles stay valid even though objects move within the dense array.
+    assert(names.erase(alice));
+    assert(!names.contains(alice));
+    assert(names.get(alice) == nullptr);
+    assert(*names.get(bob) == "bbb");
+    assert(names.size() == 1);
+
+    // Erasing twice is harmless.
+    assert(!names.erase(alice));
+}
+
+
+void test_slot_map_stale_handles() {
+    slot_map<int> values;
+    slot_handle first = values.insert(1);
+    values.erase(first);
+
+    // The slot is recycled, but with a new generation.
+    slot_handle second = values.insert(2);
+    assert(second.index == first.index);
+    assert(second.generation != first.generation);
+    assert(values.get(first) == nullptr);
+    assert(*values.get(second) == 2);
+
+    // Unlike a weak_ptr, a stale handle costs no memory: there's no
+    // control block that outlives the object.
+}
+
+
+void test_slot_map_dense_iteration() {
+    slot_map<int> values;
+    vector<slot_handle> handles;
+    for (int i = 0; i < 100; ++i) {
+        handles.push_back(values.insert(i));
+    }
+    // Drop every odd value.
+    for (int i = 1; i < 100; i += 2) {
+        values.erase(handles[i]);
+    }
+
+    int sum = 0;
+    for (int v : values) {
+        assert(v % 2 == 0);
+        sum += v;
+    }
+    assert(sum == 2450);
+
+    for (int i = 0; i < 100; ++i) {
+        assert(values.contains(handles[i]) == (i % 2 == 0));
+        if (i % 2 == 0) {
+            assert(*values.get(handles[i]) == i);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: lookup and liveness checks through
+// handles vs. 'weak_ptr'. Run with 'make bench'.
+//
+template<typename F>
+static double ns_per_op(size_t ops, F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+
+struct particle {
+    float x, y, z;
+    float vx, vy, vz;
+};
+
+
+void bench_slot_map() {
+    cout << "ns per op, random access order" << endl;
+    cout << setw(10) << "objects" << setw(10) << "lock()" << setw(10) << "get()"
+         << setw(11) << "expired()" << setw(11) << "contains()"
+         << setw(12) << "iter ptrs" << setw(12) << "iter dense" << endl;
+
+    mt19937 rng{42};
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        const size_t repeat = 10000000 / n;
+
+        vector<shared_ptr<particle>> owners;
+        vector<weak_ptr<particle>> weak;
+        slot_map<particle> particles;
+        vector<slot_handle> handles;
+        for (size_t i = 0; i < n; ++i) {
+            particle p{float(i), 0, 0, 1, 1, 1};
+            owners.push_back(make_shared<particle>(p));
+            weak.push_back(owners.back());
+            handles.push_back(particles.insert(p));
+        }
+        // Kill every 4th object.
+        for (size_t i = 0; i < n; i += 4) {
+            owners[i].reset();
+            particles.erase(handles[i]);
+        }
+        vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) order[i] = i;
+        shuffle(order.begin(), order.end(), rng);
+
+        volatile float sink = 0;
+        double lock = ns_per_op(n * repeat, [&] {
+            float sum = 0;
+            for (size_t r = 0; r < repeat; ++r) {
+                for (size_t i : order) {
+                    if (auto p = weak[i].lock()) sum += p->x;
+                }
+            }
+            sink = sum;
+        });
+        double get = ns_per_op(n * repeat, [&] {
+            float sum = 0;
+            for (size_t r = 0; r < repeat; ++r) {
+                for (size_t i : order) {
+                    if (auto p = particles.get(handles[i])) sum += p->x;
+                }
+            }
+            sink = sum;
+        });
+        double expired = ns_per_op(n * repeat, [&] {
+            size_t alive = 0;
+            for (size_t r = 0; r < repeat; ++r) {
+                for (size_t i : order) alive += !weak[i].expired();
+            }
+            sink = float(alive);
+        });
+        double contains = ns_per_op(n * repeat, [&] {
+            size_t alive = 0;
+            for (size_t r = 0; r < repeat; ++r) {
+                for (size_t i : order) alive += particles.contains(handles[i]);
+            }
+            sink = float(alive);
+        });
+        // Batch update: every live object, pointer chasing vs. dense array.
+        double iter_ptrs = ns_per_op(n * repeat, [&] {
+            for (size_t r = 0; r < repeat; ++r) {
+                for (auto& p : owners) {
+                    if (p) p->x += p->vx;
+                }
+            }
+        });
+        double iter_dense = ns_per_op(n * repeat, [&] {
+            for (size_t r = 0; r < repeat; ++r) {
+                for (auto& p : particles) p.x += p.vx;
+            }
+        });
+        (void)sink;
+
+        cout << fixed << setprecision(2)
+             << setw(10) << n << setw(10) << lock << setw(10) << get
+             << setw(11) << expired << setw(11) << contains
+             << setw(12) << iter_ptrs << setw(12) << iter_dense << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_slot_map_basic();
+    test_slot_map_stale_handles();
+    test_slot_map_dense_iteration();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_slot_map();
+    }
+
+    return 0;
+}
@@ -0,0 +1,411 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <system_error>
+#include <chrono>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'regex_replace(text, re, fmt)' needs the whole
+// input as one string and builds the whole output
+// as another one. For multi-GB inputs, that is
+// twice the input size in memory.
+//
+// 'regex_replacer' is fed the input piece by piece
+// and writes the result to an output iterator as
+// it goes. It keeps only a small window of the
+// input: a match found near the end of the window
+// might continue -- or a match might start -- in
+// data that hasn't arrived yet, so the window has
+// to cover the longest possible match. That length
+// must be given by the caller; it's what bounds
+// the memory:
+//
+//     window <= chunk size + max_match_length + 1
+//
+// Within that limit, the output is the same as
+// 'regex_replace' on the complete input, including
+// empty matches and '^', '$' and '\b'. (Only the
+// format codes $` and $' are different: they see
+// the window instead of the whole text.)
+//
+template<typename OutputIt>
+class regex_replacer {
+public:
+    regex_replacer(const regex& re, string fmt, size_t max_match_length, OutputIt out)
+        : re_(re), fmt_(move(fmt)), max_match_length_{max_match_length}, out_{out} { }
+
+    // Appends input; writes everything that can't be part of a future match.
+    void write(const char* data, size_t size) {
+        window_.append(data, size);
+        process(false);
+    }
+
+    // Signals the end of the input; writes the rest.
+    OutputIt finish() {
+        process(true);
+        window_.clear();
+        pos_ = 0;
+        return out_;
+    }
+
+    size_t window_capacity() const { return window_.capacity(); }
+
+private:
+    void process(bool at_end) {
+        const char* first = window_.data();
+        const char* last = first + window_.size();
+        // Nothing may be decided on a match that ends this close to 'last'.
+        const size_t unsafe = at_end ? 0 : max_match_length_ + 1;
+        auto is_safe = [&](const char* match_start) {
+            return at_end || static_cast<size_t>(last - match_start) > unsafe;
+        };
+
+        cmatch m;
+        for (;;) {
+            const char* p = first + pos_;
+            auto flags = regex_constants::match_default;
+            if (p != first || started_) {
+                // The window keeps one byte in front of 'pos_' for '^' and '\b'.
+                flags |= regex_constants::match_prev_avail;
+            }
+            if (!at_end) {
+                flags |= regex_constants::match_not_eol | regex_constants::match_not_eow;
+            }
+            if (last_was_empty_) {
+                // Like 'regex_iterator': after an empty match, first look for a
+                // non-empty one at the same place, then move on by one byte.
+                if (p == last || !is_safe(p)) {
+                    if (at_end) {
+                        break;
+                    }
+                    compact();
+                    return;
+                }
+                auto retry = flags | regex_constants::match_not_null | regex_constants::match_continuous;
+                if (regex_search(p, last, m, re_, retry)) {
+                    replace(m);
+                    continue;
+                }
+                *out_++ = *p;
+                ++pos_;
+                last_was_empty_ = false;
+                continue;
+            }
+            if (!regex_search(p, last, m, re_, flags)) {
+                // No match can start before 'last - unsafe'.
+                const char* safe_end = at_end ? last : max(p, last - min(unsafe, static_cast<size_t>(last - first)));
+                out_ = copy(p, safe_end, out_);
+                pos_ = safe_end - first;
+                break;
+            }
+            if (!is_safe(m[0].first)) {
+                // Might still grow, or be preceded by a match that needs more input.
+                out_ = copy(p, m[0].first, out_);
+                pos_ = m[0].first - first;
+                break;
+            }
+            replace(m);
+        }
+        compact();
+    }
+
+    void replace(const cmatch& m) {
+        const char* first = window_.data();
+        out_ = copy(first + pos_, m[0].first, out_);
+        out_ = m.format(out_, fmt_);
+        pos_ = m[0].second - first;
+        last_was_empty_ = m[0].length() == 0;
+        started_ = true;
+    }
+
+    // Drops written input, except for the byte in front of 'pos_'.
+    void compact() {
+        if (pos_ > 1) {
+            window_.erase(0, pos_ - 1);
+            pos_ = 1;
+            started_ = true;
+        }
+    }
+
+    const regex& re_;
+    const string fmt_;
+    const size_t max_match_length_;
+    OutputIt out_;
+    string window_;
+    size_t pos_ = 0;                // First byte not written yet.
+    bool started_ = false;          // Whether input was dropped in front of the window.
+    bool last_was_empty_ = false;
+};
+
+
+template<typename OutputIt>
+regex_replacer<OutputIt> make_regex_replacer(const regex& re, string fmt, size_t max_match_length, OutputIt out) {
+    return regex_replacer<OutputIt>(re, move(fmt), max_match_length, out);
+}
+
+
+// Replaces from a stream to an output iterator, 'chunk_size' bytes at a time.
+template<typename OutputIt>
+OutputIt stream_replace(istream& in, OutputIt out, const regex& re, string fmt,
+                        size_t max_match_length, size_t chunk_size = 64 * 1024) {
+    auto replacer = make_regex_replacer(re, move(fmt), max_match_length, out);
+    vector<char> chunk(chunk_size);
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+        replacer.write(chunk.data(), static_cast<size_t>(in.gcount()));
+    }
+    return replacer.finish();
+}
+
+
+// Same for a file descriptor. Throws 'system_error' if reading fails.
+template<typename OutputIt>
+OutputIt stream_replace(int fd, OutputIt out, const regex& re, string fmt,
+                        size_t max_match_length, size_t chunk_size = 64 * 1024) {
+    auto replacer = make_regex_replacer(re, move(fmt), max_match_length, out);
+    vector<char> chunk(chunk_size);
+    for (;;) {
+        ssize_t n = read(fd, chunk.data(), chunk.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error{errno, system_category(), "read"};
+        }
+        if (n == 0) {
+            break;
+        }
+        replacer.write(chunk.data(), static_cast<size_t>(n));
+    }
+    return replacer.finish();
+}
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+static string replace_in_pieces(const string& text, const regex& re, const string& fmt,
+                                size_t max_match_length, size_t piece) {
+    string result;
+    auto replacer = make_regex_replacer(re, fmt, max_match_length, back_inserter(result));
+    for (size_t i = 0; i < text.size(); i += piece) {
+        replacer.write(text.data() + i, min(piece, text.size() - i));
+    }
+    replacer.finish();
+    return result;
+}
+
+
+void test_stream_replace_essential() {
+    // The example from the 'regex' chapter, through a stream.
+    istringstream in("the quick brown fox jumps over the lazy dog");
+    ostringstream out;
+    stream_replace(in, ostreambuf_iterator<char>(out), regex("dog"), "cat", 3, 4);
+    assert(out.str() == "the quick brown fox jumps over the lazy cat");
+}
+
+
+void test_stream_replace_vs_regex_replace() {
+    string text;
+    for (int i = 0; i < 50; ++i) {
+        text += "mailto:user" + to_string(i) + "@example.org, cat concat " + to_string(i * i) + " dog\n";
+    }
+    struct {
+        const char* pattern;
+        const char* fmt;
+        size_t max_match_length;
+    } cases[] = {
+        { "dog", "cat", 3 },
+        { R"(mailto:(\w+)@([\w.]+))", "<$2/$1>", 40 },
+        { R"(\d+)", "#", 8 },
+        { R"(\bcat\b)", "[$&]", 3 },
+        { "^m|g$", "!", 1 },
+        { "a*", "-", 2 },       // Empty matches.
+        { R"(x?)", "$$", 1 },
+    };
+    for (auto& c : cases) {
+        const regex re{c.pattern};
+        const string expected = regex_replace(text, re, c.fmt);
+        for (size_t piece : { 1, 2, 3, 7, 64, 100000 }) {
+            assert(replace_in_pieces(text, re, c.fmt, c.max_match_length, piece) == expected);
+        }
+    }
+}
+
+
+void test_stream_replace_memory_bound() {
+    // The window never holds more than a chunk plus the longest match.
+    string text(1000000, 'x');
+    text += "needle";
+    const regex re{"needle"};
+    string result;
+    auto replacer = make_regex_replacer(re, "found", 6, back_inserter(result));
+    size_t max_window = 0;
+    for (size_t i = 0; i < text.size(); i += 1000) {
+        replacer.write(text.data() + i, min<size_t>(1000, text.size() - i));
+        max_window = max(max_window, replacer.window_capacity());
+    }
+    replacer.finish();
+    assert(max_window < 2 * (1000 + 6 + 1));
+    assert(result.size() == 1000005 && result.compare(1000000, 5, "found") == 0);
+}
+
+
+void test_stream_replace_fd() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    const string text("ssn 123-45-6789 and 987-65-4321\n");
+    assert(write(fds[1], text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+    close(fds[1]);
+    string out;
+    stream_replace(fds[0], back_inserter(out), regex(R"(\d{3}-\d{2}-\d{4})"), "XXX-XX-XXXX", 11, 5);
+    close(fds[0]);
+    assert(out == "ssn XXX-XX-XXXX and XXX-XX-XXXX\n");
+
+    try {
+        stream_replace(-1, back_inserter(out), regex("x"), "", 1);
+        assert(false);
+    } catch (const system_error& e) {
+        assert(e.code().value() == EBADF);
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: redacting email addresses in a
+// generated file, whole-file 'regex_replace' vs.
+// 'stream_replace'. Each variant runs in a child
+// process, so that its peak RSS can be measured.
+// Run with 'make bench'; pass the file size in MiB
+// as second argument (default 128).
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+// Runs 'f' in a child process and stores its peak RSS in MiB. Returns false
+// if the child couldn't be started or didn't exit normally.
+template<typename F>
+static bool run_child(F f, double& peak_mib) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        f();
+        _exit(0);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return false;
+    }
+    peak_mib = usage.ru_maxrss / 1024.0;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+static bool same_content(const string& path1, const string& path2) {
+    ifstream in1(path1, ios::binary), in2(path2, ios::binary);
+    vector<char> b1(1 << 16), b2(1 << 16);
+    for (;;) {
+        in1.read(b1.data(), b1.size());
+        in2.read(b2.data(), b2.size());
+        if (in1.gcount() != in2.gcount() || !equal(b1.begin(), b1.begin() + in1.gcount(), b2.begin())) {
+            return false;
+        }
+        if (in1.gcount() == 0) {
+            return true;
+        }
+    }
+}
+
+
+void bench_stream_replace(size_t mib) {
+    const string prefix = "/tmp/stream_replace_" + to_string(getpid());
+    const string input = prefix + ".in", whole_out = prefix + ".whole", stream_out = prefix + ".stream";
+    {
+        ofstream out(input, ios::binary);
+        unsigned seed = 5;
+        for (size_t bytes = 0; bytes < mib * 1024 * 1024; ) {
+            seed = seed * 1103515245 + 12345;
+            string line = "2024-01-01 user login from user" + to_string(seed % 10000) + "@example.org status ok\n";
+            out << line;
+            bytes += line.size();
+        }
+    }
+    const char* pattern = R"([\w.]+@[\w.]+)";
+    const char* fmt = "<redacted>";
+
+    bool ok = true;
+    double rss_whole = 0;
+    double t_whole = seconds([&] {
+        ok = run_child([&] {
+            ifstream in(input, ios::binary);
+            string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            string result = regex_replace(text, regex(pattern), fmt);
+            ofstream(whole_out, ios::binary) << result;
+        }, rss_whole) && ok;
+    });
+    double rss_stream = 0;
+    double t_stream = seconds([&] {
+        ok = run_child([&] {
+            int fd = open(input.c_str(), O_RDONLY);
+            ofstream out(stream_out, ios::binary);
+            stream_replace(fd, ostreambuf_iterator<char>(out), regex(pattern), fmt, 256);
+            close(fd);
+        }, rss_stream) && ok;
+    });
+    if (!ok) {
+        cout << "Redacting emails in " << mib << " MiB: a child process failed" << endl;
+    } else {
+        assert(same_content(whole_out, stream_out));
+
+        const double mb = mib * 1024 * 1024 / 1e6;
+        cout << "Redacting emails in " << mib << " MiB" << endl;
+        cout << setw(16) << "" << setw(10) << "MB/s" << setw(16) << "peak RSS MiB" << endl;
+        cout << fixed << setprecision(1)
+             << setw(16) << "regex_replace" << setw(10) << mb / t_whole << setw(16) << rss_whole << endl
+             << setw(16) << "stream_replace" << setw(10) << mb / t_stream << setw(16) << rss_stream << endl;
+    }
+
+    unlink(input.c_str());
+    unlink(whole_out.c_str());
+    unlink(stream_out.c_str());
+}
+
+
+int main(int argc, char* argv[]) {
+    test_stream_replace_essential();
+    test_stream_replace_vs_regex_replace();
+    test_stream_replace_memory_bound();
+    test_stream_replace_fd();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_stream_replace(argc > 2 ? strtoul(argv[2], nullptr, 10) : 128);
+    }
+
+    return 0;
+}
@@ -0,0 +1,503 @@
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Chaining algorithms the usual way,
+//
+//     copy_if(v.begin(), v.end(), back_inserter(even), is_even);
+//     transform(even.begin(), even.end(), back_inserter(squares), square);
+//
+// makes one pass per step and a temporary vector
+// between each two steps.
+//
+// A lazy pipeline only describes the steps:
+//
+//     from(v) | filter(is_even) | map(square) | take(10) | collect()
+//
+// Nothing runs until the last, "terminal" stage
+// ('collect', 'reduce' or 'parallel_reduce'). It
+// nests the stages into a chain of lambdas, each
+// of which passes an element on to the next one,
+// and then runs one loop over the source that
+// feeds the chain. The compiler inlines the chain
+// into that loop, so all steps are fused and no
+// intermediate container is needed. A stage
+// returns false to stop the loop early, which is
+// how 'take' avoids looking at the rest.
+//
+// 'parallel_reduce' splits the source into one
+// chunk per thread; each thread runs its own copy
+// of the chain. The partial results are combined
+// in order, so 'op' must be associative. 'take'
+// depends on the order of elements and can't be
+// used with it. With two arguments, the elements
+// must be of type T and 'op' is T(T, T): a chunk
+// starts from its first element, and 'op' also
+// combines the partials. For an 'op' that takes
+// other elements, like 'long(long, int)', pass a
+// separate T(T, T) 'combine'; then every chunk
+// starts from 'init', which must be an identity
+// of 'combine' (like 0 for '+').
+//
+// 'from' keeps a reference to the range, which
+// must outlive the pipeline.
+//
+namespace lazy {
+
+struct stage_tag { };
+struct terminal_tag { };
+
+
+template<typename Pred>
+struct filter_stage : stage_tag {
+    Pred pred;
+
+    template<typename In>
+    using output_type = In;
+
+    template<typename Sink>
+    auto wrap(Sink sink) const {
+        return [pred = pred, sink](auto&& x) mutable -> bool {
+            return pred(x) ? sink(std::forward<decltype(x)>(x)) : true;
+        };
+    }
+};
+
+
+template<typename F>
+struct map_stage : stage_tag {
+    F fn;
+
+    template<typename In>
+    using output_type = decay_t<invoke_result_t<const F&, const In&>>;
+
+    template<typename Sink>
+    auto wrap(Sink sink) const {
+        return [fn = fn, sink](auto&& x) mutable -> bool {
+            return sink(fn(std::forward<decltype(x)>(x)));
+        };
+    }
+};
+
+
+struct take_stage : stage_tag {
+    size_t n;
+
+    template<typename In>
+    using output_type = In;
+
+    template<typename Sink>
+    auto wrap(Sink sink) const {
+        return [remaining = n, sink](auto&& x) mutable -> bool {
+            if (remaining == 0) {
+                return false;
+            }
+            --remaining;
+            return sink(std::forward<decltype(x)>(x)) && remaining > 0;
+        };
+    }
+};
+
+
+template<typename Pred>
+filter_stage<Pred> filter(Pred pred) { return {{}, std::move(pred)}; }
+
+template<typename F>
+map_stage<F> map(F fn) { return {{}, std::move(fn)}; }
+
+inline take_stage take(size_t n) { return {{}, n}; }
+
+
+// Element type after all stages.
+template<typename In, typename... Stages>
+struct output_of {
+    using type = In;
+};
+
+template<typename In, typename Stage, typename... Stages>
+struct output_of<In, Stage, Stages...> {
+    using type = typename output_of<typename Stage::template output_type<In>, Stages...>::type;
+};
+
+
+template<typename Range, typename... Stages>
+class pipeline {
+public:
+    using input_type = decay_t<decltype(*std::begin(declval<const Range&>()))>;
+    using value_type = typename output_of<input_type, Stages...>::type;
+
+    static constexpr bool ordered = (is_same_v<Stages, take_stage> || ...);
+
+    pipeline(const Range& range, tuple<Stages...> stages) : range_{&range}, stages_{std::move(stages)} { }
+
+    template<typename Stage, typename = enable_if_t<is_base_of_v<stage_tag, Stage>>>
+    friend pipeline<Range, Stages..., Stage> operator|(const pipeline& p, Stage stage) {
+        return { *p.range_, tuple_cat(p.stages_, make_tuple(std::move(stage))) };
+    }
+
+    template<typename Terminal, typename = enable_if_t<is_base_of_v<terminal_tag, Terminal>>>
+    friend auto operator|(const pipeline& p, const Terminal& terminal) {
+        return terminal.run(p);
+    }
+
+    // Feeds the elements of [first, last) through the stages into 'sink',
+    // until the source ends or a stage returns false.
+    template<typename It, typename Sink>
+    void run(It first, It last, Sink sink) const {
+        auto chain = wrap<sizeof...(Stages)>(std::move(sink));
+        for (; first != last; ++first) {
+            if (!chain(*first)) {
+                break;
+            }
+        }
+    }
+
+    template<typename Sink>
+    void run(Sink sink) const {
+        run(std::begin(*range_), std::end(*range_), std::move(sink));
+    }
+
+    const Range& range() const { return *range_; }
+
+private:
+    // The first stage ends up outermost, the sink innermost.
+    template<size_t I, typename Sink>
+    auto wrap(Sink sink) const {
+        if constexpr (I == 0) {
+            return sink;
+        } else {
+            return wrap<I - 1>(get<I - 1>(stages_).wrap(std::move(sink)));
+        }
+    }
+
+    const Range* range_;
+    tuple<Stages...> stages_;
+};
+
+
+template<typename Range>
+pipeline<Range> from(const Range& range) { return { range, {} }; }
+
+// A temporary would be gone before the pipeline runs.
+template<typename Range>
+void from(const Range&& range) = delete;
+
+
+struct collect_t : terminal_tag {
+    template<typename Pipeline>
+    vector<typename Pipeline::value_type> run(const Pipeline& p) const {
+        vector<typename Pipeline::value_type> result;
+        p.run([&result](auto&& x) {
+            result.push_back(std::forward<decltype(x)>(x));
+            return true;
+        });
+        return result;
+    }
+};
+
+inline collect_t collect() { return {}; }
+
+
+template<typename T, typename Op>
+struct reduce_t : terminal_tag {
+    T init;
+    Op op;
+
+    template<typename Pipeline>
+    T run(const Pipeline& p) const {
+        T result = init;
+        p.run([&](auto&& x) {
+            result = op(std::move(result), std::forward<decltype(x)>(x));
+            return true;
+        });
+        return result;
+    }
+};
+
+template<typename T, typename Op>
+reduce_t<T, Op> reduce(T init, Op op) { return {{}, std::move(init), std::move(op)}; }
+
+
+template<typename T, typename Op, typename Combine, bool InitIsIdentity>
+struct parallel_reduce_t : terminal_tag {
+    T init;
+    Op op;
+    Combine combine;
+    unsigned threads;
+
+    template<typename Pipeline>
+    T run(const Pipeline& p) const {
+        static_assert(!Pipeline::ordered, "take() depends on the order of elements; use reduce()");
+        static_assert(InitIsIdentity || is_same_v<typename Pipeline::value_type, T>,
+                      "the elements aren't of type T; pass a separate T(T, T) combine op");
+        auto first = std::begin(p.range());
+        size_t size = static_cast<size_t>(std::distance(first, std::end(p.range())));
+        size_t chunks = max<size_t>(1, min<size_t>(threads != 0 ? threads : thread::hardware_concurrency(), size));
+
+        // A chunk without matching elements has no partial result, hence 'optional'.
+        vector<optional<T>> partials(chunks);
+        auto reduce_chunk = [&](size_t chunk) {
+            optional<T>& partial = partials[chunk];
+            if constexpr (InitIsIdentity) {
+                partial.emplace(init);
+            }
+            p.run(first + chunk * size / chunks, first + (chunk + 1) * size / chunks, [&](auto&& x) {
+                if (partial) {
+                    *partial = op(std::move(*partial), std::forward<decltype(x)>(x));
+                } else {
+                    partial.emplace(std::forward<decltype(x)>(x));
+                }
+                return true;
+            });
+        };
+
+        vector<thread> workers;
+        for (size_t chunk = 1; chunk < chunks; ++chunk) {
+            workers.emplace_back(reduce_chunk, chunk);
+        }
+        reduce_chunk(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        T result = init;
+        for (auto& partial : partials) {
+            if (partial) {
+                result = combine(std::move(result), std::move(*partial));
+            }
+        }
+        return result;
+    }
+};
+
+// 'threads' == 0: one per hardware thread.
+template<typename T, typename Op>
+parallel_reduce_t<T, Op, Op, false> parallel_reduce(T init, Op op, unsigned threads = 0) {
+    Op combine = op;
+    return {{}, std::move(init), std::move(op), std::move(combine), threads};
+}
+
+template<typename T, typename Op, typename Combine, typename = enable_if_t<!is_integral_v<Combine>>>
+parallel_reduce_t<T, Op, Combine, true> parallel_reduce(T init, Op op, Combine combine, unsigned threads = 0) {
+    return {{}, std::move(init), std::move(op), std::move(combine), threads};
+}
+
+}   // namespace lazy
+
+
+//////////////////////////////////////////////////
+// Counts heap allocations, for the tests.
+//
+static size_t allocation_count = 0;
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_pipeline_stages() {
+    // Block scope, so they hide 'std::map' and 'std::reduce'.
+    using lazy::from, lazy::filter, lazy::map, lazy::take, lazy::collect, lazy::reduce, lazy::parallel_reduce;
+
+    // 'copy_if' into 'even_primes', from the 'odds_and_ends' chapter.
+    const vector<int> primes{2, 3, 5, 7, 11, 13, 17, 19};
+    auto even_primes = from(primes) | filter([](int v) { return (v % 2) == 0; }) | collect();
+    assert(even_primes == vector<int>{2});
+
+    auto squares = from(primes) | map([](int v) { return v * v; }) | take(3) | collect();
+    assert((squares == vector<int>{4, 9, 25}));
+
+    // Maps can change the element type; stages apply in order.
+    auto labels = from(primes)
+                | filter([](int v) { return v > 10; })
+                | map([](int v) { return to_string(v); })
+                | map([](const string& s) { return s + "!"; })
+                | collect();
+    static_assert(is_same_v<decltype(labels), vector<string>>);
+    assert((labels == vector<string>{"11!", "13!", "17!", "19!"}));
+
+    // 'take' stops the loop: later elements aren't even looked at.
+    int seen = 0;
+    auto first_two = from(primes) | map([&seen](int v) { ++seen; return v; }) | take(2) | collect();
+    assert(first_two.size() == 2 && seen == 2);
+    assert((from(primes) | take(0) | collect()).empty());
+    assert((from(primes) | take(100) | collect()) == primes);
+
+    // Pipelines are values; each terminal runs them again.
+    auto odd = from(primes) | filter([](int v) { return v % 2 != 0; });
+    assert((odd | take(1) | collect()) == vector<int>{3});
+    assert((odd | reduce(0, plus<>{})) == 75);
+}
+
+
+void test_pipeline_no_intermediate_allocations() {
+    using lazy::from, lazy::filter, lazy::map, lazy::take, lazy::collect, lazy::reduce, lazy::parallel_reduce;
+
+    vector<int> v(1000);
+    iota(v.begin(), v.end(), 0);
+
+    size_t before = allocation_count;
+    long sum = from(v)
+             | filter([](int x) { return x % 3 == 0; })
+             | map([](int x) { return static_cast<long>(x) * x; })
+             | take(100)
+             | reduce(0L, plus<>{});
+    assert(allocation_count == before);
+
+    long expected = 0;
+    for (long x = 0; x < 300; x += 3) {
+        expected += x * x;
+    }
+    assert(sum == expected);
+}
+
+
+void test_pipeline_parallel_reduce() {
+    using lazy::from, lazy::filter, lazy::map, lazy::take, lazy::collect, lazy::reduce, lazy::parallel_reduce;
+
+    vector<int> v(100001);
+    iota(v.begin(), v.end(), 0);
+    auto squares = from(v) | filter([](int x) { return x % 2 == 0; }) | map([](int x) { return static_cast<long>(x) * x; });
+    long expected = squares | reduce(0L, plus<>{});
+    for (unsigned threads : { 1, 2, 3, 8 }) {
+        assert((squares | parallel_reduce(0L, plus<>{}, threads)) == expected);
+    }
+
+    // Partials are combined in order, so associative but not commutative ops work.
+    vector<string> words{"a", "b", "c", "d", "e", "f", "g"};
+    auto concat = from(words) | parallel_reduce(string(">"), plus<>{}, 3);
+    assert(concat == ">abcdefg");
+
+    // More threads than elements, and no elements at all.
+    assert((from(words) | filter([](const string& s) { return s == "z"; })
+                        | parallel_reduce(string("-"), plus<>{}, 16)) == "-");
+    vector<int> empty;
+    assert((from(empty) | parallel_reduce(5, plus<>{}, 4)) == 5);
+
+    // Mixed types need a separate combine op; every chunk starts from 'init'.
+    auto count = [](long n, int) { return n + 1; };
+    vector<int> thousand(1000, 7);
+    for (unsigned threads : { 1, 4, 16 }) {
+        assert((from(thousand) | parallel_reduce(0L, count, plus<>{}, threads)) == 1000);
+    }
+    assert((from(empty) | parallel_reduce(0L, count, plus<>{}, 4)) == 0);
+
+    // Don't compile:
+    // from(v) | take(10) | parallel_reduce(0, plus<>{});
+    // from(thousand) | parallel_reduce(0L, count);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: sum of the squares of the even
+// numbers (and the first 1000 of them) with
+// 'copy_if' + 'transform' into temporary vectors
+// vs. the fused pipeline, sequential and parallel.
+// Run with 'make bench'.
+//
+template<typename F>
+static double ms(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+
+void bench_lazy_pipeline(size_t n) {
+    using lazy::from, lazy::filter, lazy::map, lazy::take, lazy::collect, lazy::reduce, lazy::parallel_reduce;
+
+    vector<int> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = static_cast<int>(i % 1000);
+    }
+    auto is_even = [](int x) { return x % 2 == 0; };
+    auto square = [](int x) { return static_cast<long>(x) * x; };
+    const size_t first_n = 1000;
+
+    cout << "ms, " << n << " ints, sum of squares of the even ones" << endl;
+    cout << setw(34) << "" << setw(10) << "all" << setw(14) << "first 1000" << setw(10) << "allocs" << endl;
+
+    long sum1 = 0, sum2 = 0;
+    size_t allocations = allocation_count;
+    double t_all = ms([&] {
+        vector<int> even;
+        copy_if(v.begin(), v.end(), back_inserter(even), is_even);
+        vector<long> squares;
+        transform(even.begin(), even.end(), back_inserter(squares), square);
+        sum1 = accumulate(squares.begin(), squares.end(), 0L);
+    });
+    double t_first = ms([&] {
+        vector<int> even;
+        copy_if(v.begin(), v.end(), back_inserter(even), is_even);
+        even.resize(min(even.size(), first_n));
+        vector<long> squares;
+        transform(even.begin(), even.end(), back_inserter(squares), square);
+        sum2 = accumulate(squares.begin(), squares.end(), 0L);
+    });
+    allocations = allocation_count - allocations;
+    cout << fixed << setprecision(2) << setw(34) << "copy_if + transform + accumulate"
+         << setw(10) << t_all << setw(14) << t_first << setw(10) << allocations / 2 << endl;
+
+    long lazy1 = 0, lazy2 = 0;
+    allocations = allocation_count;
+    t_all = ms([&] { lazy1 = from(v) | filter(is_even) | map(square) | reduce(0L, plus<>{}); });
+    t_first = ms([&] { lazy2 = from(v) | filter(is_even) | map(square) | take(first_n) | reduce(0L, plus<>{}); });
+    allocations = allocation_count - allocations;
+    assert(lazy1 == sum1 && lazy2 == sum2);
+    cout << setw(34) << "from | filter | map | reduce" << setw(10) << t_all << setw(14) << t_first
+         << setw(10) << allocations / 2 << endl;
+
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max(4u, hardware); threads *= 2) {
+        long parallel = 0;
+        t_all = ms([&] { parallel = from(v) | filter(is_even) | map(square) | parallel_reduce(0L, plus<>{}, threads); });
+        assert(parallel == sum1);
+        string label = "... | parallel_reduce, " + to_string(threads) + " thr";
+        cout << setw(34) << label << setw(10) << t_all << setw(14) << "-" << setw(10) << "-" << endl;
+    }
+    cout << "(" << hardware << " hardware threads)" << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_pipeline_stages();
+    test_pipeline_no_intermediate_allocations();
+    test_pipeline_parallel_reduce();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_lazy_pipeline(argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000000);
+    }
+
+    return 0;
+}
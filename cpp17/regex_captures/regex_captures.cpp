@@ -0,0 +1,364 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <new>
+#include <stdexcept>
+#include <chrono>
+
+using namespace std;
+
+// 'dfa::regex' from the 'dfa_regex' chapter, without its tests.
+#define DFA_REGEX_LIBRARY
+#include "../../cpp11/dfa_regex/dfa_regex.cpp"
+
+
+//////////////////////////////////////////////////
+// With 'smatch', getting at a subexpression
+//
+//     if (match_results[1] == "ralf.holly") ...
+//     string user = match_results[1].str();
+//
+// builds a 'std::string' copy, and each
+// 'regex_search' into a fresh 'smatch' allocates
+// its vector of sub-matches. On top of that,
+// libstdc++'s regex executor allocates its own
+// bookkeeping on every search, which no reusable
+// result object can avoid.
+//
+// 'capture_state<N>' therefore runs on the
+// 'dfa::regex' engine of the 'dfa_regex' chapter,
+// which keeps its lazy DFAs and Pike VM buffers
+// from call to call. The state itself owns the
+// capture positions (which keep their capacity)
+// and a fixed-size array of up to N captures. Each
+// capture is a 'string_view' into the searched
+// text plus its offset, so reading a capture
+// copies nothing. Once the DFA caches have seen
+// the kind of text, 'search' and 'next' don't
+// allocate at all; the tests check that.
+//
+// Like 'dfa::regex', a state and its regex must
+// not be used by several threads at once.
+//
+struct capture {
+    string_view text;
+    size_t offset = npos;       // 'npos' if the group didn't participate.
+
+    static constexpr size_t npos = string_view::npos;
+
+    bool matched() const { return offset != npos; }
+    size_t end() const { return offset + text.size(); }
+};
+
+
+template<size_t N>
+class capture_state {
+public:
+    // Whole-text match, like 'regex_match'.
+    bool match(string_view text, const dfa::regex& re) {
+        check_groups(re);
+        const char* first = text.data();
+        const char* last = first + text.size();
+        if (!re.full_match(first, last)) {
+            return failed();
+        }
+        return found(text, re, first, last);
+    }
+
+    // First match at or after 'from', like 'regex_search'.
+    bool search(string_view text, const dfa::regex& re, size_t from = 0) {
+        check_groups(re);
+        const char* match_first;
+        const char* match_last;
+        if (!re.search(text.data() + from, text.data() + text.size(), match_first, match_last)) {
+            return failed();
+        }
+        return found(text, re, match_first, match_last);
+    }
+
+    // Next match behind the current one. After an empty match, a non-empty
+    // one at the same position comes first, like with 'sregex_iterator'.
+    bool next(string_view text, const dfa::regex& re) {
+        if (size_ == 0) {
+            return false;
+        }
+        size_t from = groups_[0].end();
+        if (groups_[0].text.empty()) {
+            const char* first = text.data() + from;
+            if (const char* last = re.non_empty_match(first, text.data() + text.size())) {
+                return found(text, re, first, last);
+            }
+            if (from == text.size()) {
+                return failed();
+            }
+            ++from;
+        }
+        return search(text, re, from);
+    }
+
+    // Number of captures, including the whole match; 0 after a failed match.
+    size_t size() const { return size_; }
+
+    const capture& operator[](size_t i) const {
+        assert(i < size_);
+        return groups_[i];
+    }
+
+    const capture* begin() const { return groups_.data(); }
+    const capture* end() const { return groups_.data() + size_; }
+
+private:
+    static void check_groups(const dfa::regex& re) {
+        if (re.mark_count() + 1 > N) {
+            throw length_error{"capture_state: regex has too many groups"};
+        }
+    }
+
+    bool found(string_view text, const dfa::regex& re, const char* first, const char* last) {
+        re.captures(first, last, slots_);
+        size_ = slots_.size() / 2;
+        for (size_t i = 0; i < size_; ++i) {
+            const char* begin = slots_[2 * i];
+            if (begin != nullptr) {
+                groups_[i].text = string_view{begin, static_cast<size_t>(slots_[2 * i + 1] - begin)};
+                groups_[i].offset = static_cast<size_t>(begin - text.data());
+            } else {
+                groups_[i] = capture{};
+            }
+        }
+        return true;
+    }
+
+    bool failed() {
+        size_ = 0;
+        return false;
+    }
+
+    vector<const char*> slots_;
+    array<capture, N> groups_{};
+    size_t size_ = 0;
+};
+
+
+//////////////////////////////////////////////////
+// Counts heap allocations, for the tests and the
+// benchmark. Not inlined, so that GCC at -O2
+// doesn't warn about 'free' on a pointer from
+// 'operator new'.
+//
+static size_t allocation_count = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc{};
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_captures_subexpression() {
+    // The example from the 'regex' chapter.
+    const string text("mailto:ralf.holly@approxion.com");
+    const dfa::regex re{R"(mailto:(\S+)@(\S+))"};
+
+    capture_state<3> state;
+    assert(state.search(text, re));
+    assert(state.size() == 1 + 2);
+    assert(state[0].text == text);
+    assert(state[1].text == "ralf.holly" && state[1].offset == 7);
+    assert(state[2].text == "approxion.com" && state[2].offset == 18);
+    // Views point into 'text'.
+    assert(state[2].text.data() == text.data() + 18);
+
+    assert(state.match(text, re));
+    assert(not state.match("mailto:nobody", re));
+    assert(state.size() == 0);
+
+    // Optional groups that didn't participate.
+    const dfa::regex optional_re{R"((\w+)(?:@(\w+))?)"};
+    assert(state.match("someone", optional_re));
+    assert(state[1].text == "someone" && !state[2].matched());
+
+    // Too many groups for the state.
+    capture_state<2> small;
+    try {
+        small.search(text, re);
+        assert(false);
+    } catch (const length_error&) {
+    }
+}
+
+
+void test_captures_next() {
+    const string text("a@x.org, b@y.com; c@z.net");
+    const dfa::regex email_re{R"(([\w.]+)@([\w.]+))"};
+    capture_state<3> state;
+    string users;
+    for (bool ok = state.search(text, email_re); ok; ok = state.next(text, email_re)) {
+        users += state[1].text;
+    }
+    assert(users == "abc");
+
+    // Empty matches, same as 'sregex_iterator'.
+    for (const char* pattern : { "a*", "x*|b", "x*|bc" }) {
+        const string s("baabc");
+        const regex std_re{pattern};
+        string expected;
+        for (sregex_iterator it(s.begin(), s.end(), std_re); it != sregex_iterator(); ++it) {
+            expected += "[" + it->str() + "]";
+        }
+        const dfa::regex re{pattern};
+        string runs;
+        for (bool ok = state.search(s, re); ok; ok = state.next(s, re)) {
+            runs += "[" + string(state[0].text) + "]";
+        }
+        assert(runs == expected);
+    }
+}
+
+
+void test_captures_reuse_allocations() {
+    const string text("To: ralf.holly@approxion.com, someone@example.org; x@mail.server.example.net");
+    const dfa::regex re{R"(([\w.]+)@([\w.]+))"};
+    capture_state<3> state;
+    auto extract_all = [&](const string& t) {
+        size_t matches = 0;
+        for (bool ok = state.search(t, re); ok; ok = state.next(t, re)) {
+            assert(state[1].matched() && state[2].matched());
+            ++matches;
+        }
+        return matches;
+    };
+
+    // The first pass over each text builds the DFA states it needs and the
+    // Pike VM; after that, searching and reading captures don't allocate.
+    const string other("Cc: someone@approxion.com, x@example.org");
+    assert(extract_all(text) == 3 && extract_all(other) == 2);
+    size_t before = allocation_count;
+    for (int i = 0; i < 3; ++i) {
+        assert(extract_all(text) == 3 && extract_all(other) == 2);
+    }
+    assert(allocation_count == before);
+
+    // 'std::regex' allocates on every search, even into a reused 'smatch'.
+    const regex std_re{R"(([\w.]+)@([\w.]+))"};
+    smatch match_results;
+    regex_search(text, match_results, std_re);
+    before = allocation_count;
+    regex_search(text, match_results, std_re);
+    assert(match_results[1].str() == "ralf.holly");
+    assert(allocation_count > before);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: extracting user and domain of every
+// email address in a generated text, with
+// 'std::regex' + 'smatch' + 'str()', with
+// 'dfa::regex' + 'dfa::match_results' + 'str()',
+// and with 'capture_state'. Run with 'make bench';
+// pass the number of addresses in millions as
+// second argument (default 1).
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void bench_captures(size_t millions) {
+    static const char* const users[] = { "ralf.holly", "someone", "a.very.long.user.name.indeed", "x" };
+    static const char* const domains[] = { "approxion.com", "example.org", "mail.server.example.net" };
+    string text;
+    unsigned seed = 9;
+    const size_t count = millions * 1000000;
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 1103515245 + 12345;
+        text += "To: ";
+        text += users[(seed >> 16) % 4];
+        text += '@';
+        text += domains[(seed >> 8) % 3];
+        text += ", ";
+    }
+    const regex email_re{R"(([\w.]+)@([\w.]+))"};
+    const dfa::regex dfa_email_re{R"(([\w.]+)@([\w.]+))"};
+
+    size_t n1 = 0, bytes1 = 0, allocs1 = allocation_count;
+    double t_smatch = seconds([&] {
+        smatch match_results;
+        for (auto start = text.cbegin(); regex_search(start, text.cend(), match_results, email_re,
+                 start == text.cbegin() ? regex_constants::match_default : regex_constants::match_prev_avail);
+             start = match_results[0].second) {
+            string user = match_results[1].str();
+            string domain = match_results[2].str();
+            bytes1 += user.size() + domain.size();
+            ++n1;
+        }
+    });
+    allocs1 = allocation_count - allocs1;
+
+    size_t n2 = 0, bytes2 = 0, allocs2 = allocation_count;
+    double t_dfa = seconds([&] {
+        dfa::match_results match_results;
+        const char* last = text.data() + text.size();
+        for (const char* start = text.data(); dfa::regex_search(start, last, match_results, dfa_email_re);
+             start = match_results[0].second) {
+            string user = match_results.str(1);
+            string domain = match_results.str(2);
+            bytes2 += user.size() + domain.size();
+            ++n2;
+        }
+    });
+    allocs2 = allocation_count - allocs2;
+
+    size_t n3 = 0, bytes3 = 0, allocs3 = allocation_count;
+    double t_captures = seconds([&] {
+        capture_state<3> state;
+        for (bool ok = state.search(text, dfa_email_re); ok; ok = state.next(text, dfa_email_re)) {
+            bytes3 += state[1].text.size() + state[2].text.size();
+            ++n3;
+        }
+    });
+    allocs3 = allocation_count - allocs3;
+    assert(n1 == count && n2 == count && n3 == count && bytes1 == bytes2 && bytes1 == bytes3);
+
+    cout << count << " email addresses, " << text.size() / (1024 * 1024) << " MiB" << endl;
+    cout << setw(34) << "" << setw(14) << "M matches/s" << setw(18) << "allocs per match" << endl;
+    cout << fixed << setprecision(2)
+         << setw(34) << "std::regex, smatch + str()" << setw(14) << count / t_smatch / 1e6
+         << setw(18) << double(allocs1) / count << endl
+         << setw(34) << "dfa::regex, match_results + str()" << setw(14) << count / t_dfa / 1e6
+         << setw(18) << double(allocs2) / count << endl
+         << setw(34) << "dfa::regex, capture_state" << setw(14) << count / t_captures / 1e6
+         << setw(18) << double(allocs3) / count << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_captures_subexpression();
+    test_captures_next();
+    test_captures_reuse_allocations();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_captures(argc > 2 ? strtoul(argv[2], nullptr, 10) : 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Restarting a search on a copy of the remaining
+// text, like
+//
+//     subject = match_results.suffix().str();
+//
+// copies everything behind each match. With many
+// matches in a large text that is quadratic.
+//
+// 'find_all' searches a 'string_view' in place:
+// each search starts where the previous match
+// ended, and every match is handed out as a
+// 'string_view' into the original buffer. Nothing
+// is copied, so the text -- and the regex -- must
+// outlive the range.
+//
+class match_iterator {
+public:
+    using iterator_category = input_iterator_tag;
+    using value_type = string_view;
+    using difference_type = ptrdiff_t;
+    using pointer = const string_view*;
+    using reference = string_view;
+
+    // End iterator.
+    match_iterator() = default;
+
+    match_iterator(string_view text, const regex& re)
+        : text_{text}, re_{&re}, next_{text.data()} {
+        advance();
+    }
+
+    string_view operator*() const {
+        return string_view{match_[0].first, static_cast<size_t>(match_[0].length())};
+    }
+
+    // Offset of the current match within the text.
+    size_t position() const { return static_cast<size_t>(match_[0].first - text_.data()); }
+
+    // Access to subexpressions; they point into the original text, too.
+    const cmatch& match_results() const { return match_; }
+
+    string_view group(size_t i) const {
+        return string_view{match_[i].first, static_cast<size_t>(match_[i].length())};
+    }
+
+    match_iterator& operator++() {
+        advance();
+        return *this;
+    }
+
+    bool operator==(const match_iterator& other) const {
+        return re_ == other.re_ && (re_ == nullptr || next_ == other.next_);
+    }
+
+    bool operator!=(const match_iterator& other) const { return !(*this == other); }
+
+private:
+    void advance() {
+        const char* end = text_.data() + text_.size();
+        auto flags = regex_constants::match_default;
+        if (next_ != text_.data()) {
+            // Let '^' and '\b' see the character before the search start.
+            flags |= regex_constants::match_prev_avail;
+        }
+        if (last_was_empty_) {
+            // After an empty match, first look for a non-empty match at the
+            // same position, then move on by one character.
+            if (next_ == end) {
+                re_ = nullptr;
+                return;
+            }
+            auto retry = flags | regex_constants::match_not_null | regex_constants::match_continuous;
+            if (regex_search(next_, end, match_, *re_, retry)) {
+                found();
+                return;
+            }
+            ++next_;
+            flags |= regex_constants::match_prev_avail;
+        }
+        if (regex_search(next_, end, match_, *re_, flags)) {
+            found();
+        } else {
+            re_ = nullptr;
+        }
+    }
+
+    void found() {
+        next_ = match_[0].second;
+        last_was_empty_ = match_[0].length() == 0;
+    }
+
+    string_view text_;
+    const regex* re_ = nullptr;
+    const char* next_ = nullptr;
+    bool last_was_empty_ = false;
+    cmatch match_;
+};
+
+
+class match_range {
+public:
+    match_range(string_view text, const regex& re) : text_{text}, re_{re} { }
+
+    match_iterator begin() const { return match_iterator{text_, re_}; }
+    match_iterator end() const { return match_iterator{}; }
+
+private:
+    string_view text_;
+    const regex& re_;
+};
+
+
+inline match_range find_all(string_view text, const regex& re) {
+    return match_range{text, re};
+}
+
+// A temporary regex would be gone before the loop body runs.
+match_range find_all(string_view text, const regex&& re) = delete;
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_find_all_numbers() {
+    const string text("aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap");
+    const regex number_re{R"(\d+)"};
+
+    vector<string_view> numbers;
+    for (string_view number : find_all(text, number_re)) {
+        numbers.push_back(number);
+    }
+    assert((numbers == vector<string_view>{"1", "22", "333", "4444", "55555"}));
+
+    // Views point right into 'text'.
+    assert(numbers[1].data() == text.data() + 10);
+}
+
+
+void test_find_all_positions_and_groups() {
+    const string text("mailto:ralf.holly@approxion.com, mailto:someone@example.org");
+    const regex mailto_re{R"(mailto:([^@\s,]+)@([^\s,]+))"};
+
+    auto it = find_all(text, mailto_re).begin();
+    assert(it.position() == 0);
+    assert(it.group(1) == "ralf.holly");
+    assert(it.group(2) == "approxion.com");
+    ++it;
+    assert(it.position() == 33);
+    assert(it.group(1) == "someone");
+    assert(it.group(2) == "example.org");
+    ++it;
+    assert(it == match_iterator{});
+}
+
+
+void test_find_all_anchors_and_empty_matches() {
+    // '\b' needs to see the character in front of the restart position.
+    const string text("cat concat cat");
+    const regex cat_re{R"(\bcat\b)"};
+    size_t count = 0;
+    for (string_view word : find_all(text, cat_re)) {
+        assert(word == "cat");
+        ++count;
+    }
+    assert(count == 2);
+
+    // Empty matches don't get stuck, and non-empty ones aren't skipped.
+    const string s("baac");
+    const regex re{"a*"};
+    vector<string_view> runs;
+    for (string_view run : find_all(s, re)) {
+        runs.push_back(run);
+    }
+    assert((runs == vector<string_view>{"", "aa", "", ""}));
+
+    // Same result as 'sregex_iterator'.
+    vector<string> expected;
+    for (sregex_iterator it(s.begin(), s.end(), re); it != sregex_iterator(); ++it) {
+        expected.push_back(it->str());
+    }
+    assert(expected.size() == runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+        assert(expected[i] == runs[i]);
+    }
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: suffix-copy loop vs. 'sregex_iterator'
+// vs. 'find_all' on generated text. Run with
+// 'make bench'; pass the largest size in MiB as
+// second argument (default 64).
+//
+static string make_corpus(size_t bytes) {
+    static const char* const words[] = { "aaa", "bbb", "dddae", "foo", "bar", "zap" };
+    string text;
+    text.reserve(bytes + 32);
+    unsigned seed = 1;
+    while (text.size() < bytes) {
+        seed = seed * 1103515245 + 12345;
+        text += words[(seed >> 16) % 6];
+        text += ' ';
+        if ((seed >> 8) % 4 == 0) {
+            text += to_string(seed % 100000);
+            text += ' ';
+        }
+    }
+    return text;
+}
+
+
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void bench_find_all(size_t max_mib) {
+    const regex number_re{R"(\d+)"};
+    // The quadratic loop is only run where it finishes in reasonable time.
+    const size_t max_suffix_copy = 256 * 1024;
+
+    cout << "MB/s, \\d+ over generated text" << endl;
+    cout << setw(10) << "size" << setw(14) << "suffix copy" << setw(16) << "sregex_iter" << setw(12) << "find_all" << endl;
+    for (size_t size = 64 * 1024; size <= max_mib * 1024 * 1024; size *= 4) {
+        const string text = make_corpus(size);
+        const double mb = text.size() / 1e6;
+        size_t c1 = 0, c2 = 0, c3 = 0;
+
+        double suffix = 0;
+        if (size <= max_suffix_copy) {
+            suffix = seconds([&] {
+                smatch match_results;
+                auto subject = text;
+                while (regex_search(subject, match_results, number_re)) {
+                    c1 += match_results[0].length();
+                    subject = match_results.suffix().str();
+                }
+            });
+        }
+        double iter = seconds([&] {
+            for (sregex_iterator it(text.begin(), text.end(), number_re); it != sregex_iterator(); ++it) {
+                c2 += (*it)[0].length();
+            }
+        });
+        double views = seconds([&] {
+            for (string_view number : find_all(text, number_re)) {
+                c3 += number.size();
+            }
+        });
+        assert(c2 == c3 && (c1 == 0 || c1 == c3));
+
+        cout << setw(9) << size / 1024 << "K" << fixed << setprecision(1);
+        if (suffix > 0) cout << setw(14) << mb / suffix; else cout << setw(14) << "skipped";
+        cout << setw(16) << mb / iter << setw(12) << mb / views << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_find_all_numbers();
+    test_find_all_positions_and_groups();
+    test_find_all_anchors_and_empty_matches();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_find_all(argc > 2 ? strtoul(argv[2], nullptr, 10) : 64);
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <array>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// The recursive 'combine' from the variadic
+// templates chapter computes
+//
+//     a + (b + (c + ... ))
+//
+// For strings, every level returns a temporary
+// that holds everything to its right, so N pieces
+// are copied O(N^2) times in total, with up to N
+// allocations.
+//
+// 'str_cat' first turns each argument into a view
+// of its characters, adds up the lengths, reserves
+// once, and appends each piece once. Besides
+// strings, string views and characters it takes
+// integers, which are formatted with 'to_chars':
+// no locale, no allocation.
+//
+namespace detail {
+
+class str_piece {
+public:
+    str_piece(const string& s) : view_{s} { }
+    str_piece(const char* s) : view_{s} { }
+    str_piece(string_view s) : view_{s} { }
+    str_piece(char c) : view_{buffer_, 1} { buffer_[0] = c; }
+
+    template<typename Int, typename = enable_if_t<is_integral_v<Int> && !is_same_v<Int, char>>>
+    str_piece(Int value) {
+        auto result = to_chars(buffer_, buffer_ + sizeof(buffer_), value);
+        view_ = string_view{buffer_, static_cast<size_t>(result.ptr - buffer_)};
+    }
+
+    // 'true' would print as "1"; that's hardly ever intended.
+    str_piece(bool) = delete;
+
+    // The view may point into the piece itself, so pieces stay put.
+    str_piece(const str_piece&) = delete;
+    str_piece& operator=(const str_piece&) = delete;
+
+    string_view view() const { return view_; }
+
+private:
+    string_view view_;
+    char buffer_[numeric_limits<uint64_t>::digits10 + 2];  // Enough for a signed 64-bit value.
+};
+
+}
+
+
+// Appends all arguments to 'dest', with at most one reallocation.
+template<typename... Args>
+void str_append(string& dest, const Args&... args) {
+    // The trailing empty piece keeps the array valid for zero arguments.
+    const detail::str_piece pieces[] = { detail::str_piece(args)..., detail::str_piece(string_view{}) };
+    size_t total = dest.size();
+    for (const auto& piece : pieces) {
+        total += piece.view().size();
+    }
+    dest.reserve(total);
+    for (const auto& piece : pieces) {
+        dest.append(piece.view());
+    }
+}
+
+
+template<typename... Args>
+string str_cat(const Args&... args) {
+    string result;
+    str_append(result, args...);
+    return result;
+}
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_str_cat() {
+    assert(str_cat() == "");
+    assert(str_cat("a") == "a");
+    assert(str_cat(string("a"), string("b"), string("hello")) == "abhello");
+
+    const string s("string");
+    const char* cs = "c-string";
+    string_view sv("view");
+    assert(str_cat(s, ' ', cs, ' ', sv) == "string c-string view");
+
+    // Integers of all sizes, without locale influence.
+    assert(str_cat(1, 2, 3) == "123");
+    assert(str_cat("min=", numeric_limits<int64_t>::min(), " max=", numeric_limits<uint64_t>::max())
+           == "min=-9223372036854775808 max=18446744073709551615");
+    assert(str_cat(static_cast<unsigned char>(200), static_cast<signed char>(-5), short(-300)) == "200-5-300");
+}
+
+
+void test_str_append() {
+    string dest("x=");
+    str_append(dest, 42, ", y=", -1);
+    assert(dest == "x=42, y=-1");
+
+    // One reservation for everything.
+    string big;
+    str_append(big, string(100, 'a'), string(200, 'b'), 12345);
+    assert(big.size() == 305 && big.capacity() < 2 * 305);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: 'combine' from the variadic templates
+// chapter vs. 'str_cat' for 2 to 64 strings.
+// Run with 'make bench'.
+//
+template<typename Arg>
+Arg combine(Arg arg) {
+    return arg;
+}
+
+
+template<typename FirstArg, typename... RemArgs>
+FirstArg combine(FirstArg first_arg, RemArgs... rem_args) {
+    return first_arg + combine(rem_args...);
+}
+
+
+template<typename F>
+static double ns_per_op(size_t ops, F f) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        f();
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+
+template<size_t... I>
+void bench_str_cat_n(const vector<string>& words, index_sequence<I...>) {
+    constexpr size_t n = sizeof...(I);
+    const size_t ops = 200000 / n;
+    size_t total = 0;
+    double t_combine = ns_per_op(ops, [&] { total += combine(words[I]...).size(); });
+    double t_str_cat = ns_per_op(ops, [&] { total += str_cat(words[I]...).size(); });
+    assert(combine(words[I]...) == str_cat(words[I]...));
+
+    cout << fixed << setprecision(1) << setw(6) << n << setw(14) << t_combine << setw(14) << t_str_cat
+         << setw(10) << t_combine / t_str_cat << "x" << (total == 0 ? "!" : "") << endl;
+}
+
+
+void bench_str_cat() {
+    vector<string> words;
+    for (int i = 0; i < 64; ++i) {
+        words.push_back("word" + to_string(i) + "_of_text");
+    }
+    cout << "ns per concatenation of N strings (~11 characters each)" << endl;
+    cout << setw(6) << "N" << setw(14) << "combine" << setw(14) << "str_cat" << setw(11) << "speedup" << endl;
+    bench_str_cat_n(words, make_index_sequence<2>());
+    bench_str_cat_n(words, make_index_sequence<4>());
+    bench_str_cat_n(words, make_index_sequence<8>());
+    bench_str_cat_n(words, make_index_sequence<16>());
+    bench_str_cat_n(words, make_index_sequence<32>());
+    bench_str_cat_n(words, make_index_sequence<64>());
+}
+
+
+int main(int argc, char* argv[]) {
+    test_str_cat();
+    test_str_append();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_str_cat();
+    }
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <cstring>
+#include <cassert>
+#include <cstdlib>
+
+#include <utility>
+
+#if !defined(COMPILE_COST_VARIANT)
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Three ways to process a parameter pack, here to
+// add up all arguments like 'combine' in the
+// variadic templates chapter:
+//
+// 1. Recursion: strip one argument, call yourself
+//    with the rest. N arguments instantiate N
+//    functions, with 1, 2, ..., N parameters.
+// 2. A C++17 fold expression: one instantiation.
+// 3. 'index_sequence': copy the arguments into an
+//    array of the first one's type and expand
+//    'args[I]' over the indices -- the C++11/14 way
+//    to get at pack elements without recursion.
+//    (Packing them into a 'tuple' instead mostly
+//    measures libstdc++'s recursive 'tuple'.)
+//
+// Which one is cheapest to compile is best
+// measured. 'make bench' compiles this file once
+// per variant and argument count N (8..512); each
+// time, only the variant under test is enabled by
+// -DCOMPILE_COST_VARIANT and -DCOMPILE_COST_ARGS.
+// It records compile time, the compiler's peak
+// memory, and the object file size. The template
+// instantiation depth limit is raised to 2048, so
+// that no variant fails just for hitting the
+// default; 'failed' means the compiler gave up
+// anyway, or couldn't be started.
+//
+namespace recursive {
+
+template<typename Arg>
+Arg combine(Arg arg) {
+    return arg;
+}
+
+template<typename FirstArg, typename... RemArgs>
+FirstArg combine(FirstArg first_arg, RemArgs... rem_args) {
+    return first_arg + combine(rem_args...);
+}
+
+}
+
+
+namespace fold {
+
+template<typename FirstArg, typename... RemArgs>
+FirstArg combine(FirstArg first_arg, RemArgs... rem_args) {
+    return (first_arg + ... + rem_args);
+}
+
+}
+
+
+namespace indexed {
+
+template<typename T, size_t N, size_t... I>
+T combine_array(const T (&args)[N], index_sequence<I...>) {
+    T result{};
+    // Pre-C++17 pack expansion trick: an array initializer evaluates in order.
+    int expand[] = { (result = result + args[I], 0)... };
+    (void)expand;
+    return result;
+}
+
+// All arguments must convert to the type of the first one.
+template<typename FirstArg, typename... RemArgs>
+FirstArg combine(FirstArg first_arg, RemArgs... rem_args) {
+    const FirstArg args[] = { first_arg, rem_args... };
+    return combine_array(args, make_index_sequence<1 + sizeof...(RemArgs)>());
+}
+
+}
+
+
+//////////////////////////////////////////////////
+// The translation unit that gets measured: one
+// call with COMPILE_COST_ARGS arguments, read from
+// an array so that nothing is constant-folded.
+//
+#if defined(COMPILE_COST_VARIANT)
+
+#if COMPILE_COST_VARIANT == 1
+namespace variant = recursive;
+#elif COMPILE_COST_VARIANT == 2
+namespace variant = fold;
+#else
+namespace variant = indexed;
+#endif
+
+template<size_t... I>
+long probe(const long* values, index_sequence<I...>) {
+    return variant::combine(values[I]...);
+}
+
+long probe(const long* values) {
+    return probe(values, make_index_sequence<COMPILE_COST_ARGS>());
+}
+
+#else
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+template<size_t... I>
+void check_all_variants(index_sequence<I...>) {
+    const long values[] = { static_cast<long>(I)... };
+    const long expected = static_cast<long>(sizeof...(I) * (sizeof...(I) - 1) / 2);
+    assert(recursive::combine(values[I]...) == expected);
+    assert(fold::combine(values[I]...) == expected);
+    assert(indexed::combine(values[I]...) == expected);
+}
+
+
+void test_variants() {
+    assert(recursive::combine(1, 2, 3) == 6);
+    assert(fold::combine(1, 2, 3) == 6);
+    assert(indexed::combine(1, 2, 3) == 6);
+    assert(fold::combine(string("a"), string("b"), string("hello")) == "abhello");
+    assert(indexed::combine(string("a"), string("b"), string("hello")) == "abhello");
+
+    check_all_variants(make_index_sequence<1>());
+    check_all_variants(make_index_sequence<64>());
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: compile cost per variant and N.
+// Run with 'make bench', which passes $(CXX).
+//
+struct compile_cost {
+    bool ok;
+    double seconds;         // User + system time of the compiler.
+    double peak_mib;        // Largest RSS of the driver or cc1plus.
+    long object_bytes;
+};
+
+
+static compile_cost compile(const string& cxx, int variant, size_t args) {
+    const string object = "/tmp/variadic_compile_cost_" + to_string(getpid()) + ".o";
+    vector<string> argv_strings = {
+        cxx, "-std=c++17", "-O2", "-ftemplate-depth=2048", "-c", "-o", object, __FILE__,
+        "-DCOMPILE_COST_VARIANT=" + to_string(variant),
+        "-DCOMPILE_COST_ARGS=" + to_string(args),
+    };
+    vector<char*> argv;
+    for (auto& s : argv_strings) {
+        argv.push_back(&s[0]);
+    }
+    argv.push_back(nullptr);
+
+    compile_cost cost{};
+    pid_t pid = fork();
+    if (pid < 0) {
+        return cost;        // Not 'ok'.
+    }
+    if (pid == 0) {
+        // Keep the table readable if a variant fails to compile.
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, 2);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    // Includes the compiler's own children (cc1plus, as), which it waited for.
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return cost;
+    }
+
+    cost.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    cost.seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+                 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    cost.peak_mib = usage.ru_maxrss / 1024.0;
+    struct stat st;
+    cost.object_bytes = stat(object.c_str(), &st) == 0 ? static_cast<long>(st.st_size) : 0;
+    unlink(object.c_str());
+    return cost;
+}
+
+
+void bench_compile_cost(const string& cxx) {
+    static const char* const names[] = { "recursive", "fold", "index_sequence" };
+    cout << "Compile cost of one call with N arguments, " << cxx << " -O2 -c" << endl;
+    cout << setw(6) << "N" << setw(16) << "variant" << setw(10) << "seconds"
+         << setw(12) << "peak MiB" << setw(12) << "object KiB" << endl;
+    for (size_t args = 8; args <= 512; args *= 2) {
+        for (int variant = 1; variant <= 3; ++variant) {
+            compile_cost cost = compile(cxx, variant, args);
+            cout << setw(6) << args << setw(16) << names[variant - 1];
+            if (cost.ok) {
+                cout << fixed << setprecision(2) << setw(10) << cost.seconds
+                     << setprecision(1) << setw(12) << cost.peak_mib << setw(12) << cost.object_bytes / 1024.0 << endl;
+            } else {
+                cout << setw(10) << "failed" << endl;
+            }
+        }
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    test_variants();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_compile_cost(argc > 2 ? argv[2] : "g++");
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,695 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <chrono>
+
+#if !defined(COMPILE_COST_PROBE) || COMPILE_COST_PROBE == 2
+#include <regex>
+#endif
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// All patterns in the 'regex' chapter are string
+// literals, yet 'std::regex' parses them at run-time
+// and interprets the resulting automaton. Since
+// C++20, a class type can be a template parameter,
+// so a pattern can be handed to a template:
+//
+//     ct_regex<R"(mailto:(\S+)@(\S+))">::search(text, m)
+//
+// The pattern is parsed by a 'constexpr' function
+// while compiling. The matcher is a set of function
+// templates, one instantiation per syntax tree node,
+// that dispatch with 'if constexpr' -- no run-time
+// parsing, no interpretation, and code the compiler
+// can inline into the call site. An invalid pattern
+// is a compile-time error.
+//
+// Supported: literals, '.', '\d', '\D', '\s', '\S',
+// '\w', '\W', escaped metacharacters, '[...]' sets,
+// '|', groups ('(...)' and '(?:...)') and greedy
+// '*', '+', '?'. Semantics are ECMAScript's
+// (leftmost-first backtracking), like 'std::regex'.
+// Lazy quantifiers ('*?', '+?', '??') are rejected
+// like any other unsupported syntax.
+//
+
+
+//////////////////////////////////////////////////
+// A string literal that can be used as template
+// argument.
+//
+template<size_t N>
+struct fixed_string {
+    char chars[N] = {};
+
+    constexpr fixed_string(const char (&s)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            chars[i] = s[i];
+        }
+    }
+
+    constexpr size_t size() const { return N - 1; }
+    constexpr char operator[](size_t i) const { return chars[i]; }
+};
+
+
+//////////////////////////////////////////////////
+// Compile-time syntax tree. Everything is public
+// and of literal type, so that a whole tree can be
+// a 'static constexpr' member and its nodes can be
+// inspected in 'if constexpr' conditions.
+//
+struct char_set {
+    uint64_t bits[4] = {};
+
+    constexpr void add(unsigned char c) { bits[c / 64] |= uint64_t{1} << (c % 64); }
+    constexpr void add_range(unsigned char lo, unsigned char hi) {
+        for (unsigned c = lo; c <= hi; ++c) add(static_cast<unsigned char>(c));
+    }
+    constexpr void add(const char_set& other) {
+        for (int i = 0; i < 4; ++i) bits[i] |= other.bits[i];
+    }
+    constexpr void invert() {
+        for (auto& b : bits) b = ~b;
+    }
+    constexpr bool test(unsigned char c) const { return (bits[c / 64] >> (c % 64)) & 1; }
+};
+
+
+enum class node_kind { chars, empty, concat, alternate, star, plus, quest, group };
+
+
+struct node {
+    node_kind kind = node_kind::empty;
+    char_set set;           // 'chars'.
+    int first_child = 0;    // Index into 'syntax_tree::children'.
+    int child_count = 0;
+    int group = 0;          // 'group': capture index, 0 for non-capturing.
+};
+
+
+template<size_t Capacity>
+struct syntax_tree {
+    array<node, Capacity> nodes{};
+    array<int, Capacity> children{};
+    int node_count = 0;
+    int child_count = 0;
+    int root = 0;
+    int groups = 0;
+};
+
+
+template<size_t Capacity>
+class ct_parser {
+public:
+    constexpr ct_parser(const char* pattern, size_t size) : p_{pattern}, size_{size} { }
+
+    constexpr syntax_tree<Capacity> parse() {
+        tree_.root = parse_alternation();
+        if (pos_ != size_) {
+            throw "unbalanced ')'";     // Not a constant expression: compile error.
+        }
+        return tree_;
+    }
+
+private:
+    constexpr int add(node n) {
+        tree_.nodes[tree_.node_count] = n;
+        return tree_.node_count++;
+    }
+
+    constexpr int add_parent(node_kind kind, const int* items, int count, int group = 0) {
+        node n;
+        n.kind = kind;
+        n.first_child = tree_.child_count;
+        n.child_count = count;
+        n.group = group;
+        for (int i = 0; i < count; ++i) {
+            tree_.children[tree_.child_count++] = items[i];
+        }
+        return add(n);
+    }
+
+    constexpr bool at_end() const { return pos_ == size_; }
+    constexpr char peek() const { return p_[pos_]; }
+
+    constexpr int parse_alternation() {
+        array<int, Capacity> items{};
+        int count = 0;
+        items[count++] = parse_concat();
+        while (!at_end() && peek() == '|') {
+            ++pos_;
+            items[count++] = parse_concat();
+        }
+        return count == 1 ? items[0] : add_parent(node_kind::alternate, items.data(), count);
+    }
+
+    constexpr int parse_concat() {
+        array<int, Capacity> items{};
+        int count = 0;
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            items[count++] = parse_repeat();
+        }
+        if (count == 0) {
+            return add(node{});
+        }
+        return count == 1 ? items[0] : add_parent(node_kind::concat, items.data(), count);
+    }
+
+    constexpr int parse_repeat() {
+        int atom = parse_atom();
+        if (!at_end() && (peek() == '*' || peek() == '+' || peek() == '?')) {
+            char q = p_[pos_++];
+            node_kind kind = q == '*' ? node_kind::star : q == '+' ? node_kind::plus : node_kind::quest;
+            atom = add_parent(kind, &atom, 1);
+        }
+        if (!at_end() && (peek() == '*' || peek() == '+' || peek() == '?')) {
+            // 'a*?' is lazy in ECMAScript, not a greedy loop made optional.
+            throw "lazy or repeated quantifiers are not supported";
+        }
+        return atom;
+    }
+
+    constexpr int parse_atom() {
+        char c = p_[pos_++];
+        char_set set;
+        switch (c) {
+        case '(': {
+            int group = 0;
+            if (pos_ + 1 < size_ && p_[pos_] == '?' && p_[pos_ + 1] == ':') {
+                pos_ += 2;
+            } else {
+                group = ++tree_.groups;
+            }
+            int body = parse_alternation();
+            if (at_end() || peek() != ')') {
+                throw "missing ')'";
+            }
+            ++pos_;
+            return add_parent(node_kind::group, &body, 1, group);
+        }
+        case '[':
+            set = parse_bracket();
+            break;
+        case '.':
+            // Anything but line terminators.
+            set.add('\n');
+            set.add('\r');
+            set.invert();
+            break;
+        case '\\':
+            set = parse_escape();
+            break;
+        case '*': case '+': case '?': case ')': case '{': case '^': case '$':
+            throw "unsupported or misplaced metacharacter";
+        default:
+            set.add(static_cast<unsigned char>(c));
+        }
+        node n;
+        n.kind = node_kind::chars;
+        n.set = set;
+        return add(n);
+    }
+
+    constexpr char_set parse_escape() {
+        if (at_end()) {
+            throw "trailing backslash";
+        }
+        char c = p_[pos_++];
+        char_set set;
+        switch (c) {
+        case 'd': case 'D':
+            set.add_range('0', '9');
+            break;
+        case 's': case 'S':
+            for (char ws : { ' ', '\t', '\n', '\r', '\f', '\v' }) set.add(static_cast<unsigned char>(ws));
+            break;
+        case 'w': case 'W':
+            set.add_range('a', 'z');
+            set.add_range('A', 'Z');
+            set.add_range('0', '9');
+            set.add('_');
+            break;
+        case 'n': set.add('\n'); return set;
+        case 't': set.add('\t'); return set;
+        default:
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+                throw "unsupported escape";
+            }
+            set.add(static_cast<unsigned char>(c));
+            return set;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            set.invert();
+        }
+        return set;
+    }
+
+    constexpr char_set parse_bracket() {
+        char_set set;
+        bool negate = !at_end() && peek() == '^';
+        if (negate) {
+            ++pos_;
+        }
+        for (bool first = true; ; first = false) {
+            if (at_end()) {
+                throw "missing ']'";
+            }
+            char c = p_[pos_++];
+            if (c == ']' && !first) {
+                break;
+            }
+            if (c == '\\') {
+                set.add(parse_escape());
+            } else if (pos_ + 1 < size_ && peek() == '-' && p_[pos_ + 1] != ']') {
+                set.add_range(static_cast<unsigned char>(c), static_cast<unsigned char>(p_[pos_ + 1]));
+                pos_ += 2;
+            } else {
+                set.add(static_cast<unsigned char>(c));
+            }
+        }
+        if (negate) {
+            set.invert();
+        }
+        return set;
+    }
+
+    const char* p_;
+    size_t size_;
+    size_t pos_ = 0;
+    syntax_tree<Capacity> tree_{};
+};
+
+
+//////////////////////////////////////////////////
+// Match results: fixed-size arrays of views into
+// the subject, no allocation.
+//
+template<size_t Count>
+struct ct_match {
+    array<string_view, Count> groups{};
+    array<bool, Count> matched{};
+
+    constexpr size_t size() const { return Count; }
+    constexpr string_view operator[](size_t i) const { return groups[i]; }
+};
+
+
+//////////////////////////////////////////////////
+// The matcher. 'match_node<N>' matches node N at
+// 'p' and then calls the continuation 'k' with the
+// position behind it; if 'k' fails, the next
+// alternative is tried (backtracking).
+//
+template<fixed_string Pattern>
+class ct_regex {
+    static constexpr auto tree = ct_parser<2 * sizeof(Pattern.chars) + 2>{Pattern.chars, Pattern.size()}.parse();
+
+public:
+    static constexpr size_t mark_count = tree.groups;
+    using match_type = ct_match<mark_count + 1>;
+
+    // Whole subject must match.
+    static constexpr bool match(string_view subject) {
+        match_type m;
+        return match(subject, m);
+    }
+
+    static constexpr bool match(string_view subject, match_type& m) {
+        const char* first = subject.data();
+        const char* last = first + subject.size();
+        m = match_type{};
+        cursor c{first, last, &m};
+        if (!match_node<tree.root>(c, first, [&](const char* q) { return q == last; })) {
+            return false;
+        }
+        m.groups[0] = subject;
+        m.matched[0] = true;
+        return true;
+    }
+
+    static constexpr bool search(string_view subject) {
+        match_type m;
+        return search(subject, m);
+    }
+
+    static constexpr bool search(string_view subject, match_type& m) {
+        const char* first = subject.data();
+        const char* last = first + subject.size();
+        m = match_type{};
+        cursor c{first, last, &m};
+        const char* end = nullptr;
+        for (const char* start = first; start <= last; ++start) {
+            if constexpr (first_set_known()) {
+                // Skip positions where the first character can't match.
+                while (start != last && !first_set().test(static_cast<unsigned char>(*start))) {
+                    ++start;
+                }
+                if (start == last) {
+                    break;
+                }
+            }
+            if (match_node<tree.root>(c, start, [&](const char* q) { end = q; return true; })) {
+                m.groups[0] = string_view{start, static_cast<size_t>(end - start)};
+                m.matched[0] = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct cursor {
+        const char* first;
+        const char* last;
+        match_type* m;
+    };
+
+    // If the pattern starts with a mandatory character set, that's it.
+    static constexpr int leading_chars(int n) {
+        const node& nd = tree.nodes[n];
+        switch (nd.kind) {
+        case node_kind::chars: return n;
+        case node_kind::concat: return leading_chars(tree.children[nd.first_child]);
+        case node_kind::plus:
+        case node_kind::group: return leading_chars(tree.children[nd.first_child]);
+        default: return -1;
+        }
+    }
+
+    static constexpr bool first_set_known() { return leading_chars(tree.root) >= 0; }
+    static constexpr char_set first_set() { return tree.nodes[leading_chars(tree.root)].set; }
+
+    template<int N>
+    static constexpr int child(int i) { return tree.children[tree.nodes[N].first_child + i]; }
+
+    template<int N, typename K>
+    static constexpr bool match_node(cursor& c, const char* p, K&& k) {
+        constexpr node nd = tree.nodes[N];
+        if constexpr (nd.kind == node_kind::chars) {
+            return p != c.last && nd.set.test(static_cast<unsigned char>(*p)) && k(p + 1);
+        } else if constexpr (nd.kind == node_kind::empty) {
+            return k(p);
+        } else if constexpr (nd.kind == node_kind::concat) {
+            return match_sequence<N, 0>(c, p, k);
+        } else if constexpr (nd.kind == node_kind::alternate) {
+            return match_alternative<N, 0>(c, p, k);
+        } else if constexpr (nd.kind == node_kind::quest) {
+            return match_node<child<N>(0)>(c, p, k) || k(p);
+        } else if constexpr (nd.kind == node_kind::star || nd.kind == node_kind::plus) {
+            constexpr node body = tree.nodes[child<N>(0)];
+            constexpr size_t min = nd.kind == node_kind::plus ? 1 : 0;
+            if constexpr (body.kind == node_kind::chars) {
+                // Single character loop: run to the end, then give back one by one.
+                const char* q = p;
+                while (q != c.last && body.set.test(static_cast<unsigned char>(*q))) {
+                    ++q;
+                }
+                for (; static_cast<size_t>(q - p) >= min; --q) {
+                    if (k(q)) {
+                        return true;
+                    }
+                    if (q == p) {
+                        break;
+                    }
+                }
+                return false;
+            } else {
+                return match_loop<child<N>(0), min>(c, p, 0, k);
+            }
+        } else if constexpr (nd.kind == node_kind::group) {
+            if constexpr (nd.group == 0) {
+                return match_node<child<N>(0)>(c, p, k);
+            } else {
+                return match_node<child<N>(0)>(c, p, [&](const char* q) {
+                    string_view saved = c.m->groups[nd.group];
+                    bool was_matched = c.m->matched[nd.group];
+                    c.m->groups[nd.group] = string_view{p, static_cast<size_t>(q - p)};
+                    c.m->matched[nd.group] = true;
+                    if (k(q)) {
+                        return true;
+                    }
+                    c.m->groups[nd.group] = saved;
+                    c.m->matched[nd.group] = was_matched;
+                    return false;
+                });
+            }
+        }
+        return false;
+    }
+
+    template<int N, int I, typename K>
+    static constexpr bool match_sequence(cursor& c, const char* p, K&& k) {
+        if constexpr (I + 1 == tree.nodes[N].child_count) {
+            return match_node<child<N>(I)>(c, p, k);
+        } else {
+            return match_node<child<N>(I)>(c, p, [&](const char* q) {
+                return match_sequence<N, I + 1>(c, q, k);
+            });
+        }
+    }
+
+    template<int N, int I, typename K>
+    static constexpr bool match_alternative(cursor& c, const char* p, K&& k) {
+        if constexpr (I + 1 == tree.nodes[N].child_count) {
+            return match_node<child<N>(I)>(c, p, k);
+        } else {
+            return match_node<child<N>(I)>(c, p, k) || match_alternative<N, I + 1>(c, p, k);
+        }
+    }
+
+    // General greedy loop. Like in ECMAScript, an iteration that consumes
+    // nothing counts towards 'Min', but ends the loop once 'Min' is reached.
+    template<int Body, size_t Min, typename K>
+    static constexpr bool match_loop(cursor& c, const char* p, size_t done, K& k) {
+        bool more = match_node<Body>(c, p, [&](const char* q) {
+            return (q != p || done < Min) && match_loop<Body, Min>(c, q, done + 1, k);
+        });
+        return more || (done >= Min && k(p));
+    }
+};
+
+
+#if defined(LAZY_QUANTIFIER_PROBE)
+
+// Must not compile: 'make test' checks that it's rejected.
+bool probe(string_view s) {
+    return ct_regex<"b.*?a">::search(s);
+}
+
+#elif defined(COMPILE_COST_PROBE)
+
+//////////////////////////////////////////////////
+// Minimal translation units for 'make compile_cost'.
+//
+#if COMPILE_COST_PROBE == 1
+bool probe(string_view s) {
+    return ct_regex<R"(mailto:(\S+)@(\S+))">::search(s) && ct_regex<R"(\d+)">::search(s);
+}
+#else
+bool probe(const string& s) {
+    return regex_search(s, regex{R"(mailto:(\S+)@(\S+))"}) && regex_search(s, regex{R"(\d+)"});
+}
+#endif
+
+#else
+
+//////////////////////////////////////////////////
+// Tests: the examples of the 'regex' chapter.
+// Many of them can even run at compile-time.
+//
+void test_ct_regex_essential() {
+    constexpr string_view text("the quick brown fox jumps over the lazy dog");
+
+    static_assert(ct_regex<"quick">::search(text));
+    static_assert(not ct_regex<"bamboozled">::search(text));
+    static_assert(ct_regex<"the quick brown.*dog">::match(text));
+    static_assert(not ct_regex<"the quick brown.*cat">::match(text));
+    static_assert(ct_regex<"(fox|dog) jumps">::search(text));
+
+    // At run-time, too.
+    string subject(text);
+    assert(ct_regex<"quick">::search(subject));
+    assert(ct_regex<"[a-z]+ [a-z]+">::match("hello world"));
+    assert(not ct_regex<"[a-z]+ [a-z]+">::match("hello world!"));
+}
+
+
+void test_ct_regex_subexpression() {
+    const string text("mailto:ralf.holly@approxion.com");
+
+    using mailto = ct_regex<R"(mailto:(\S+)@(\S+))">;
+    static_assert(mailto::mark_count == 2);
+    mailto::match_type match_results;
+    assert(mailto::search(text, match_results));
+    assert(match_results.size() == 1 + 2);
+    assert(match_results[0] == text);
+    assert(match_results[1] == "ralf.holly");
+    assert(match_results[2] == "approxion.com");
+
+    // Greedy backtracking picks the last '@', like std::regex does.
+    assert(mailto::search("mailto:a@b@c", match_results));
+    assert(match_results[1] == "a@b" && match_results[2] == "c");
+}
+
+
+void test_ct_regex_search_all() {
+    string_view subject("aaa 1 bbb 22 dddae 333 foo 4444 bar55555 zap");
+    string_view expected[] = { "1", "22", "333", "4444", "55555" };
+
+    using number = ct_regex<R"(\d+)">;
+    number::match_type m;
+    size_t count = 0;
+    while (number::search(subject, m)) {
+        assert(m[0] == expected[count++]);
+        subject.remove_prefix(m[0].data() + m[0].size() - subject.data());
+    }
+    assert(count == 5);
+}
+
+
+void test_ct_regex_groups() {
+    using re = ct_regex<"(a|ab)(c|bcd)(d*)">;
+    re::match_type m;
+    assert(re::search("abcd", m));
+    assert(m[1] == "a" && m[2] == "bcd" && m[3] == "");
+
+    using optional = ct_regex<"colou?r(?:ful)?">;
+    static_assert(optional::match("color") && optional::match("colourful"));
+    static_assert(optional::mark_count == 0);
+
+    using nested = ct_regex<"(?:ab)+c">;
+    static_assert(nested::match("ababc") && not nested::match("abac"));
+}
+
+
+// Loops whose body can match the empty string, compared with std::regex.
+// Only whole matches are compared: for '(a*)+b' on "ab", libstdc++ reports an
+// extra empty iteration in group 1, where ECMAScript keeps "a".
+template<fixed_string Pattern>
+void check_like_std_regex(const char* pattern, initializer_list<const char*> texts) {
+    const regex std_re{pattern};
+    for (const char* text : texts) {
+        typename ct_regex<Pattern>::match_type m;
+        cmatch expected;
+        bool found = regex_search(text, expected, std_re);
+        assert(ct_regex<Pattern>::search(text, m) == found);
+        assert(!found || m[0] == string_view(expected[0].first, expected[0].length()));
+    }
+}
+
+
+void test_ct_regex_empty_iterations() {
+    // '+' needs one iteration, even an empty one.
+    static_assert(ct_regex<"(a*)+b">::match("b") && ct_regex<"(?:x?)+y">::match("y"));
+    check_like_std_regex<"(a*)+b">("(a*)+b", { "b", "ab", "aab", "xb", "a" });
+    check_like_std_regex<"(?:x?)+y">("(?:x?)+y", { "y", "xy", "xxy", "ay", "x" });
+    check_like_std_regex<"(a|b*)*c">("(a|b*)*c", { "c", "abc", "bbac", "d" });
+
+    using repeated_group = ct_regex<"(a*)+b">;
+    repeated_group::match_type m;
+    assert(repeated_group::search("b", m) && m[0] == "b" && m[1] == "");
+    assert(repeated_group::search("ab", m) && m[0] == "ab" && m[1] == "a");
+}
+
+
+// ct_regex<"(abc">  -- Error: not a constant expression (missing ')').
+// ct_regex<"b.*?a">  -- Error: lazy quantifiers aren't supported ('make test'
+//                      checks that this one doesn't compile).
+
+
+//////////////////////////////////////////////////
+// Benchmark: match throughput of the two patterns,
+// compile-time regex vs. 'std::regex'. Run with
+// 'make bench'; 'make compile_cost' compares the
+// build time of both.
+//
+template<typename F>
+static double seconds(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void bench_ct_regex() {
+    // Lines like the chapter's examples.
+    string lines[1000];
+    for (size_t i = 0; i < 1000; ++i) {
+        lines[i] = i % 2 ? "contact: mailto:user" + to_string(i) + "@example" + to_string(i % 7) + ".com"
+                         : "aaa " + to_string(i) + " bbb " + to_string(i * 7) + " ccc";
+    }
+    const size_t rounds = 200;
+    size_t bytes = 0;
+    for (auto& line : lines) bytes += line.size();
+    const double mb = bytes * rounds / 1e6;
+
+    const regex std_mailto{R"(mailto:(\S+)@(\S+))"};
+    const regex std_number{R"(\d+)"};
+    using ct_mailto = ct_regex<R"(mailto:(\S+)@(\S+))">;
+    using ct_number = ct_regex<R"(\d+)">;
+
+    size_t n1 = 0, n2 = 0;
+    double std_m = seconds([&] {
+        smatch m;
+        for (size_t r = 0; r < rounds; ++r)
+            for (auto& line : lines) n1 += regex_search(line, m, std_mailto) ? m[2].length() : 0;
+    });
+    double ct_m = seconds([&] {
+        ct_mailto::match_type m;
+        for (size_t r = 0; r < rounds; ++r)
+            for (auto& line : lines) n2 += ct_mailto::search(line, m) ? m[2].size() : 0;
+    });
+    assert(n1 == n2);
+    double std_n = seconds([&] {
+        for (size_t r = 0; r < rounds; ++r)
+            for (auto& line : lines)
+                for (sregex_iterator it(line.begin(), line.end(), std_number); it != sregex_iterator(); ++it) ++n1;
+    });
+    double ct_n = seconds([&] {
+        ct_number::match_type m;
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto& line : lines) {
+                string_view rest(line);
+                while (ct_number::search(rest, m)) {
+                    ++n2;
+                    rest.remove_prefix(m[0].data() + m[0].size() - rest.data());
+                }
+            }
+        }
+    });
+    assert(n1 == n2);
+
+    cout << "MB/s over " << bytes / 1000 << " KB of lines" << endl;
+    cout << fixed << setprecision(1);
+    cout << setw(22) << "pattern" << setw(12) << "std::regex" << setw(12) << "ct_regex" << endl;
+    cout << setw(22) << R"(mailto:(\S+)@(\S+))" << setw(12) << mb / std_m << setw(12) << mb / ct_m << endl;
+    cout << setw(22) << R"(\d+ (all matches))" << setw(12) << mb / std_n << setw(12) << mb / ct_n << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_ct_regex_essential();
+    test_ct_regex_subexpression();
+    test_ct_regex_search_all();
+    test_ct_regex_groups();
+    test_ct_regex_empty_iterations();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_ct_regex();
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,501 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// Chained 'cout << a << ", " << b' goes through
+// locale-aware, virtually dispatched stream code;
+// 'snprintf' is faster, but its format string is
+// only checked by compiler warnings, and a wrong
+// conversion is undefined behavior.
+//
+// 'format_to(buffer, fmt, args...)' writes into a
+// caller-provided buffer:
+//
+// - A fixed 'char' array, or 'format_to_n' for
+//   any 'char' range: never allocates,
+//   truncates like 'snprintf' and reports the full
+//   length.
+// - A 'string': grows it as needed, so a reused
+//   string stops allocating once it's big enough.
+//
+// The format string is checked at compile time,
+// like 'std::format' (which g++ 12 doesn't have):
+// it is a 'consteval' constructor argument, and a
+// bad placeholder or a type mismatch makes it fail
+// to compile. Everything lives in namespace 'fmt',
+// so it doesn't clash with 'std::format_to' and
+// 'std::format_string' where '<format>' exists. Numbers are converted with 'to_chars',
+// directly into the buffer if there is room.
+//
+// Placeholders are '{}', '{:x}' (hexadecimal, for
+// integers) and '{:.N}' (N fractional digits, for
+// floating point); '{{' and '}}' are literal braces.
+//
+namespace fmt {
+
+enum class format_kind { none, signed_int, unsigned_int, float_single, float_double, boolean, character, string };
+
+
+template<typename T>
+constexpr format_kind format_kind_of() {
+    using U = decay_t<T>;
+    if constexpr (is_same_v<U, bool>) {
+        return format_kind::boolean;
+    } else if constexpr (is_same_v<U, char>) {
+        return format_kind::character;
+    } else if constexpr (is_integral_v<U> && is_signed_v<U>) {
+        return format_kind::signed_int;
+    } else if constexpr (is_integral_v<U>) {
+        return format_kind::unsigned_int;
+    } else if constexpr (is_same_v<U, float>) {
+        return format_kind::float_single;
+    } else if constexpr (is_same_v<U, double>) {
+        return format_kind::float_double;
+    } else if constexpr (is_same_v<U, const char*> || is_same_v<U, char*>
+                         || is_same_v<U, string> || is_same_v<U, string_view>) {
+        return format_kind::string;
+    } else {
+        return format_kind::none;
+    }
+}
+
+
+// Returns nullptr if 'fmt' fits the argument types, else what's wrong.
+template<typename... Args>
+constexpr const char* check_format(string_view fmt) {
+    constexpr format_kind kinds[] = { format_kind_of<Args>()..., format_kind::none };
+    for (size_t i = 0; i < sizeof...(Args); ++i) {
+        if (kinds[i] == format_kind::none) {
+            return "unsupported argument type";
+        }
+    }
+    size_t next_arg = 0;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] == '}') {
+            if (i + 1 == fmt.size() || fmt[i + 1] != '}') {
+                return "unmatched '}'";
+            }
+            ++i;
+        } else if (fmt[i] == '{') {
+            if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+                ++i;
+                continue;
+            }
+            size_t close = fmt.find('}', i);
+            if (close == string_view::npos) {
+                return "unmatched '{'";
+            }
+            if (next_arg == sizeof...(Args)) {
+                return "more placeholders than arguments";
+            }
+            const format_kind kind = kinds[next_arg++];
+            const string_view spec = fmt.substr(i + 1, close - i - 1);
+            if (spec == ":x") {
+                if (kind != format_kind::signed_int && kind != format_kind::unsigned_int) {
+                    return "'{:x}' needs an integer";
+                }
+            } else if (spec.size() >= 3 && spec.size() <= 4 && spec[0] == ':' && spec[1] == '.') {
+                for (char c : spec.substr(2)) {
+                    if (c < '0' || c > '9') {
+                        return "bad precision";
+                    }
+                }
+                if (kind != format_kind::float_single && kind != format_kind::float_double) {
+                    return "'{:.N}' needs a floating-point number";
+                }
+            } else if (!spec.empty()) {
+                return "unknown format spec";
+            }
+            i = close;
+        }
+    }
+    if (next_arg != sizeof...(Args)) {
+        return "more arguments than placeholders";
+    }
+    return nullptr;
+}
+
+
+// Not 'constexpr': calling it during constant evaluation is a compile error,
+// and the diagnostic shows the offending format string and argument types.
+inline void format_error(const char*) { }
+
+
+template<typename... Args>
+class basic_format_string {
+public:
+    template<size_t N>
+    consteval basic_format_string(const char (&fmt)[N]) : fmt_{fmt, N - 1} {
+        if (const char* error = check_format<Args...>(fmt_)) {
+            format_error(error);
+        }
+    }
+
+    constexpr string_view get() const { return fmt_; }
+
+private:
+    string_view fmt_;
+};
+
+
+// Keeps 'Args' from being deduced from the format string.
+template<typename... Args>
+using format_string = basic_format_string<type_identity_t<Args>...>;
+
+
+//////////////////////////////////////////////////
+// Type-erased arguments and the formatting loop.
+// The loop depends only on the output type, not
+// on the argument types, so each 'format_to' call
+// adds little code.
+//
+namespace detail {
+
+class format_arg {
+public:
+    template<typename T>
+    format_arg(const T& value) : kind_{format_kind_of<T>()} {
+        constexpr format_kind kind = format_kind_of<T>();
+        if constexpr (kind == format_kind::signed_int) {
+            i_ = value;
+        } else if constexpr (kind == format_kind::unsigned_int) {
+            u_ = value;
+        } else if constexpr (kind == format_kind::float_single) {
+            f_ = value;
+        } else if constexpr (kind == format_kind::float_double) {
+            d_ = value;
+        } else if constexpr (kind == format_kind::boolean) {
+            b_ = value;
+        } else if constexpr (kind == format_kind::character) {
+            c_ = value;
+        } else {
+            string_view s{value};
+            s_ = { s.data(), s.size() };
+        }
+    }
+
+    template<typename Out>
+    void write(Out& out, string_view spec) const {
+        switch (kind_) {
+            case format_kind::signed_int:
+                out.put_chars(i_, spec.empty() ? 10 : 16);
+                break;
+            case format_kind::unsigned_int:
+                out.put_chars(u_, spec.empty() ? 10 : 16);
+                break;
+            case format_kind::float_single:
+                if (spec.empty()) out.put_chars(f_); else out.put_chars(f_, chars_format::fixed, precision(spec));
+                break;
+            case format_kind::float_double:
+                if (spec.empty()) out.put_chars(d_); else out.put_chars(d_, chars_format::fixed, precision(spec));
+                break;
+            case format_kind::boolean:
+                out.put(b_ ? string_view{"true"} : string_view{"false"});
+                break;
+            case format_kind::character:
+                out.put(string_view{&c_, 1});
+                break;
+            default:
+                out.put(string_view{s_.data, s_.size});
+                break;
+        }
+    }
+
+private:
+    static int precision(string_view spec) {
+        int n = 0;
+        for (char c : spec.substr(2)) {
+            n = n * 10 + (c - '0');
+        }
+        return n;
+    }
+
+    format_kind kind_;
+    union {
+        long long i_;
+        unsigned long long u_;
+        float f_;
+        double d_;
+        bool b_;
+        char c_;
+        struct { const char* data; size_t size; } s_;
+    };
+};
+
+
+// Relies on 'check_format' having accepted 'fmt' for these arguments.
+template<typename Out>
+void vformat(Out& out, string_view fmt, const format_arg* args) {
+    size_t i = 0;
+    while (i < fmt.size()) {
+        size_t brace = fmt.find_first_of("{}", i);
+        if (brace == string_view::npos) {
+            out.put(fmt.substr(i));
+            break;
+        }
+        out.put(fmt.substr(i, brace - i));
+        if (fmt[brace] == fmt[brace + 1]) {
+            // "{{" or "}}".
+            out.put(fmt.substr(brace, 1));
+            i = brace + 2;
+            continue;
+        }
+        size_t close = fmt.find('}', brace);
+        (args++)->write(out, fmt.substr(brace + 1, close - brace - 1));
+        i = close + 1;
+    }
+}
+
+
+// Enough for any 'to_chars' result with a precision of at most 99.
+const size_t max_number_chars = 512;
+
+
+class buffer_writer {
+public:
+    buffer_writer(char* first, char* last) : p_{first}, last_{last} { }
+
+    void put(string_view s) {
+        size_t n = min(s.size(), static_cast<size_t>(last_ - p_));
+        memcpy(p_, s.data(), n);
+        p_ += n;
+        size_ += s.size();
+    }
+
+    template<typename... T>
+    void put_chars(T... value_and_options) {
+        // Fast path: straight into the buffer.
+        auto result = to_chars(p_, last_, value_and_options...);
+        if (result.ec == errc{}) {
+            size_ += result.ptr - p_;
+            p_ = result.ptr;
+            return;
+        }
+        char tmp[max_number_chars];
+        result = to_chars(tmp, tmp + sizeof(tmp), value_and_options...);
+        put(string_view{tmp, static_cast<size_t>(result.ptr - tmp)});
+    }
+
+    char* out() const { return p_; }
+    size_t size() const { return size_; }
+
+private:
+    char* p_;
+    char* const last_;
+    size_t size_ = 0;
+};
+
+
+class string_writer {
+public:
+    explicit string_writer(string& s) : s_{s} { }
+
+    void put(string_view s) { s_.append(s); }
+
+    template<typename... T>
+    void put_chars(T... value_and_options) {
+        char tmp[max_number_chars];
+        auto result = to_chars(tmp, tmp + sizeof(tmp), value_and_options...);
+        s_.append(tmp, result.ptr);
+    }
+
+private:
+    string& s_;
+};
+
+}
+
+
+struct format_result {
+    char* out;      // End of the output written.
+    size_t size;    // Length of the complete output; larger means truncated.
+};
+
+
+// Writes at most 'n' characters to 'first', like 'std::format_to_n'.
+template<typename... Args>
+format_result format_to_n(char* first, size_t n, format_string<Args...> fmt, const Args&... args) {
+    // The trailing dummy keeps the array valid for zero arguments.
+    const detail::format_arg arg_array[] = { detail::format_arg(args)..., detail::format_arg(0) };
+    detail::buffer_writer out{first, first + n};
+    detail::vformat(out, fmt.get(), arg_array);
+    return format_result{out.out(), out.size()};
+}
+
+
+// Writes to a 'char' array; returns what was written (not null-terminated).
+template<size_t N, typename... Args>
+string_view format_to(char (&buffer)[N], format_string<Args...> fmt, const Args&... args) {
+    format_result result = format_to_n(buffer, N, fmt, args...);
+    return string_view{buffer, static_cast<size_t>(result.out - buffer)};
+}
+
+
+// Appends to 'buffer'.
+template<typename... Args>
+void format_to(string& buffer, format_string<Args...> fmt, const Args&... args) {
+    const detail::format_arg arg_array[] = { detail::format_arg(args)..., detail::format_arg(0) };
+    detail::string_writer out{buffer};
+    detail::vformat(out, fmt.get(), arg_array);
+}
+
+}   // namespace fmt
+
+
+#if defined(FORMAT_ERROR_PROBE)
+
+//////////////////////////////////////////////////
+// Format strings that must not compile; see
+// 'make format_errors'.
+//
+void probe() {
+    char buffer[64];
+#if FORMAT_ERROR_PROBE == 1
+    fmt::format_to(buffer, "{} {}", 1);              // Too few arguments.
+#elif FORMAT_ERROR_PROBE == 2
+    fmt::format_to(buffer, "{}", 1, 2);              // Too many arguments.
+#elif FORMAT_ERROR_PROBE == 3
+    fmt::format_to(buffer, "{:x}", 1.5);             // Hex for a double.
+#elif FORMAT_ERROR_PROBE == 4
+    fmt::format_to(buffer, "{:.2}", "text");         // Precision for a string.
+#elif FORMAT_ERROR_PROBE == 5
+    fmt::format_to(buffer, "{", 1);                  // Unmatched brace.
+#else
+    fmt::format_to(buffer, "{}", &buffer);           // Unsupported type.
+#endif
+}
+
+#else
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_format_to_fixed() {
+    // 'my_func' from the variadic templates chapter.
+    int a = 42;
+    string b("hello");
+    float c = 2.5f;
+    char buffer[64];
+    assert(fmt::format_to(buffer, "a: {}, b: {}, *c: {}", a, b, c) == "a: 42, b: hello, *c: 2.5");
+
+    assert(fmt::format_to(buffer, "no args") == "no args");
+    assert(fmt::format_to(buffer, "{{{}}} {}", 'x', true) == "{x} true");
+    assert(fmt::format_to(buffer, "{:x} {:x} {}", 255, 0xdeadbeefu, -7LL) == "ff deadbeef -7");
+    assert(fmt::format_to(buffer, "{:.3} {} {}", 3.14159, 0.1, 1e100) == "3.142 0.1 1e+100");
+    assert(fmt::format_to(buffer, "{} {} {}", "c-string", string_view("view"), static_cast<unsigned char>(200))
+           == "c-string view 200");
+
+    static_assert(fmt::check_format<int, double>("{} {:.2}") == nullptr);
+    static_assert(fmt::check_format<int>("{:x} }") != nullptr);
+}
+
+
+void test_format_to_truncation() {
+    char buffer[8];
+    auto result = fmt::format_to_n(buffer, sizeof(buffer), "value={} end", 123456);
+    assert(result.size == 16);
+    assert(result.out == buffer + 8);
+    assert(string_view(buffer, 8) == "value=12");
+
+    // Numbers that don't fit are cut off, not dropped.
+    result = fmt::format_to_n(buffer, 4, "{}", 9876543210LL);
+    assert(result.size == 10 && string_view(buffer, 4) == "9876");
+}
+
+
+void test_format_to_string() {
+    string s;
+    fmt::format_to(s, "{}-{}", 1, "two");
+    fmt::format_to(s, ", {:.1}", 1234.56);
+    assert(s == "1-two, 1234.6");
+
+    // A cleared string keeps its capacity.
+    s.clear();
+    const char* data = s.data();
+    fmt::format_to(s, "{} {}", 1, 2);
+    assert(s == "1 2" && s.data() == data);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: 'ostream' chain vs. 'snprintf' vs.
+// 'format_to' for a 'my_func'-like message.
+// Run with 'make bench'.
+//
+template<typename F>
+static double ns_per_op(size_t ops, F f) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        f(i);
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+
+void bench_format_to() {
+    const size_t ops = 2000000;
+    const string b("hello");
+    size_t total = 0;
+
+    ostringstream os;
+    double t_ostream = ns_per_op(ops, [&](size_t i) {
+        os.str("");
+        os << "a: " << i << ", b: " << b << ", *c: " << i * 0.25 << ", hex: " << hex << i << dec;
+        total += os.tellp();
+    });
+
+    char buffer[128];
+    double t_snprintf = ns_per_op(ops, [&](size_t i) {
+        total += snprintf(buffer, sizeof(buffer), "a: %zu, b: %s, *c: %g, hex: %zx", i, b.c_str(), i * 0.25, i);
+    });
+
+    double t_fixed = ns_per_op(ops, [&](size_t i) {
+        total += fmt::format_to(buffer, "a: {}, b: {}, *c: {}, hex: {:x}", i, b, i * 0.25, i).size();
+    });
+
+    string s;
+    double t_string = ns_per_op(ops, [&](size_t i) {
+        s.clear();
+        fmt::format_to(s, "a: {}, b: {}, *c: {}, hex: {:x}", i, b, i * 0.25, i);
+        total += s.size();
+    });
+
+    cout << "ns per message \"a: {}, b: {}, *c: {}, hex: {:x}\"" << (total == 0 ? "!" : "") << endl;
+    cout << fixed << setprecision(1)
+         << setw(22) << "ostringstream" << setw(10) << t_ostream << endl
+         << setw(22) << "snprintf" << setw(10) << t_snprintf << endl
+         << setw(22) << "format_to char[]" << setw(10) << t_fixed << endl
+         << setw(22) << "format_to string" << setw(10) << t_string << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_format_to_fixed();
+    test_format_to_truncation();
+    test_format_to_string();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_format_to();
+    }
+
+    return 0;
+}
+
+#endif
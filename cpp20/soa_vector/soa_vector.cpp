@@ -0,0 +1,320 @@
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+
+#include <vector>
+#include <tuple>
+#include <span>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+
+//////////////////////////////////////////////////
+// 'vector<particle>' stores whole structs one after
+// another ("array of structs", AoS). A loop that
+// only reads 'x' still drags every other field
+// through the cache, and the compiler can't load
+// eight 'x' values into one SIMD register.
+//
+// 'soa_vector<Ts...>' keeps one contiguous array
+// per field type ("struct of arrays", SoA):
+//
+// - 'column<I>()' returns a 'span' over field I, so
+//   single-field loops touch only that field and
+//   vectorize.
+// - 'operator[]' and iteration yield rows as tuples
+//   of references, which work with structured
+//   bindings:
+//
+//       for (auto [x, vx] : positions) x += vx;
+//
+// Each column is a 'vector'; all of them always
+// have the same size. 'bool' columns are rejected,
+// as 'vector<bool>' has no contiguous storage.
+//
+template<typename... Ts>
+class soa_vector {
+    static_assert(sizeof...(Ts) > 0, "soa_vector needs at least one column");
+    static_assert((!is_same_v<Ts, bool> && ...), "use 'char' instead of 'bool' columns");
+
+public:
+    using value_type = tuple<Ts...>;
+    using reference = tuple<Ts&...>;
+    using const_reference = tuple<const Ts&...>;
+
+    template<size_t I>
+    using column_type = tuple_element_t<I, value_type>;
+
+    size_t size() const { return get<0>(columns_).size(); }
+    bool empty() const { return size() == 0; }
+
+    void reserve(size_t n) {
+        apply([n](auto&... column) { (column.reserve(n), ...); }, columns_);
+    }
+
+    void resize(size_t n) {
+        apply([n](auto&... column) { (column.resize(n), ...); }, columns_);
+    }
+
+    void clear() {
+        apply([](auto&... column) { (column.clear(), ...); }, columns_);
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        static_assert(sizeof...(Args) == sizeof...(Ts), "one value per column");
+        emplace_back_impl(index_sequence_for<Ts...>(), std::forward<Args>(args)...);
+    }
+
+    void push_back(const value_type& row) {
+        apply([this](const Ts&... values) { emplace_back(values...); }, row);
+    }
+
+    void pop_back() {
+        apply([](auto&... column) { (column.pop_back(), ...); }, columns_);
+    }
+
+    reference operator[](size_t i) {
+        return apply([i](auto&... column) { return reference{column[i]...}; }, columns_);
+    }
+
+    const_reference operator[](size_t i) const {
+        return apply([i](const auto&... column) { return const_reference{column[i]...}; }, columns_);
+    }
+
+    template<size_t I>
+    span<column_type<I>> column() { return get<I>(columns_); }
+
+    template<size_t I>
+    span<const column_type<I>> column() const { return get<I>(columns_); }
+
+    // Random-access iterator over rows. Dereferencing yields a proxy (a tuple of
+    // references), not a real reference, so it isn't a C++17 random-access iterator.
+    template<typename Container, typename Reference>
+    class row_iterator {
+    public:
+        using iterator_concept = random_access_iterator_tag;
+        using iterator_category = input_iterator_tag;
+        using value_type = soa_vector::value_type;
+        using difference_type = ptrdiff_t;
+        using reference = Reference;
+
+        row_iterator() = default;
+        row_iterator(Container* c, size_t i) : c_{c}, i_{i} { }
+
+        Reference operator*() const { return (*c_)[i_]; }
+        Reference operator[](difference_type n) const { return (*c_)[i_ + n]; }
+
+        row_iterator& operator++() { ++i_; return *this; }
+        row_iterator operator++(int) { auto old = *this; ++i_; return old; }
+        row_iterator& operator--() { --i_; return *this; }
+        row_iterator operator--(int) { auto old = *this; --i_; return old; }
+        row_iterator& operator+=(difference_type n) { i_ += n; return *this; }
+        row_iterator& operator-=(difference_type n) { i_ -= n; return *this; }
+        row_iterator operator+(difference_type n) const { return row_iterator{c_, i_ + n}; }
+        row_iterator operator-(difference_type n) const { return row_iterator{c_, i_ - n}; }
+        friend row_iterator operator+(difference_type n, const row_iterator& it) { return it + n; }
+        difference_type operator-(const row_iterator& other) const {
+            return static_cast<difference_type>(i_) - static_cast<difference_type>(other.i_);
+        }
+
+        bool operator==(const row_iterator& other) const { return i_ == other.i_; }
+        auto operator<=>(const row_iterator& other) const { return i_ <=> other.i_; }
+
+    private:
+        Container* c_ = nullptr;
+        size_t i_ = 0;
+    };
+
+    using iterator = row_iterator<soa_vector, reference>;
+    using const_iterator = row_iterator<const soa_vector, const_reference>;
+
+    iterator begin() { return iterator{this, 0}; }
+    iterator end() { return iterator{this, size()}; }
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, size()}; }
+
+private:
+    template<size_t... I, typename... Args>
+    void emplace_back_impl(index_sequence<I...>, Args&&... args) {
+        // Keep all columns the same size if one of them throws.
+        size_t old_size = size();
+        try {
+            (get<I>(columns_).emplace_back(std::forward<Args>(args)), ...);
+        } catch (...) {
+            ((get<I>(columns_).size() > old_size ? get<I>(columns_).pop_back() : void()), ...);
+            throw;
+        }
+    }
+
+    tuple<vector<Ts>...> columns_;
+};
+
+
+//////////////////////////////////////////////////
+// Tests.
+//
+void test_soa_vector_rows() {
+    soa_vector<float, float, int> points;
+    points.emplace_back(1.0f, 2.0f, 10);
+    points.push_back({ 3.0f, 4.0f, 20 });
+    assert(points.size() == 2);
+
+    auto [x, y, id] = points[1];
+    assert(x == 3.0f && y == 4.0f && id == 20);
+    x = 5.0f;       // Bound to the element.
+    assert(get<0>(points[1]) == 5.0f);
+
+    int sum = 0;
+    for (auto [px, py, pid] : points) {
+        py += 1.0f;
+        sum += pid;
+    }
+    assert(sum == 30);
+    assert(get<1>(points[0]) == 3.0f);
+
+    const auto& cpoints = points;
+    static_assert(is_same_v<decltype(cpoints[0]), tuple<const float&, const float&, const int&>>);
+    assert(get<2>(*(cpoints.end() - 1)) == 20);
+
+    points.pop_back();
+    assert(points.size() == 1);
+    points.clear();
+    assert(points.empty());
+}
+
+
+void test_soa_vector_columns() {
+    soa_vector<int, double> v;
+    v.resize(4);
+    auto ids = v.column<0>();
+    auto values = v.column<1>();
+    static_assert(is_same_v<decltype(ids), span<int>>);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ids[i] = static_cast<int>(i);
+        values[i] = i * 0.5;
+    }
+    assert(get<0>(v[3]) == 3 && get<1>(v[3]) == 1.5);
+
+    // Columns are contiguous.
+    assert(&v.column<0>()[3] == &v.column<0>()[0] + 3);
+
+    // Rows work with standard algorithms.
+    static_assert(random_access_iterator<soa_vector<int, double>::iterator>);
+    auto it = find_if(v.begin(), v.end(), [](auto row) { return get<1>(row) > 1.0; });
+    assert(it - v.begin() == 3);
+}
+
+
+void test_soa_vector_exception_safety() {
+    struct thrower {
+        thrower(int n) { if (n < 0) throw n; }
+    };
+    soa_vector<int, thrower> v;
+    v.emplace_back(1, 1);
+    try {
+        v.emplace_back(2, -1);
+        assert(false);
+    } catch (int) {
+    }
+    assert(v.size() == 1 && v.column<0>().size() == 1 && v.column<1>().size() == 1);
+}
+
+
+//////////////////////////////////////////////////
+// Benchmark: particles as 'vector<struct>' (AoS)
+// vs. 'soa_vector' (SoA), for a single-field scan,
+// a two-field update and full-row iteration.
+// Run with 'make bench'.
+//
+struct particle {
+    float x, y, z;
+    float vx, vy, vz;
+    float mass;
+    int id;
+};
+
+
+template<typename F>
+static double ns_per_element(size_t n, size_t rounds, F f) {
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        f();
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / (n * rounds);
+}
+
+
+void bench_soa_vector() {
+    const size_t n = 10000000;
+    const size_t rounds = 10;
+
+    vector<particle> aos(n);
+    soa_vector<float, float, float, float, float, float, float, int> soa;
+    soa.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        float f = static_cast<float>(i % 1000);
+        aos[i] = particle{f, f, f, 1.0f, 1.0f, 1.0f, 2.0f, static_cast<int>(i % 7)};
+        soa.emplace_back(f, f, f, 1.0f, 1.0f, 1.0f, 2.0f, static_cast<int>(i % 7));
+    }
+
+    long long sum_aos = 0, sum_soa = 0;
+    double scan_aos = ns_per_element(n, rounds, [&] {
+        for (const particle& p : aos) sum_aos += p.id;
+    });
+    double scan_soa = ns_per_element(n, rounds, [&] {
+        for (int id : soa.column<7>()) sum_soa += id;
+    });
+    assert(sum_aos == sum_soa);
+
+    double update_aos = ns_per_element(n, rounds, [&] {
+        for (particle& p : aos) p.x += p.vx * 0.5f;
+    });
+    double update_soa = ns_per_element(n, rounds, [&] {
+        auto x = soa.column<0>();
+        auto vx = soa.column<3>();
+        for (size_t i = 0; i < x.size(); ++i) x[i] += vx[i] * 0.5f;
+    });
+    assert(aos[n - 1].x == get<0>(soa[n - 1]));
+
+    double energy_aos = 0, energy_soa = 0;
+    double rows_aos = ns_per_element(n, rounds, [&] {
+        for (const particle& p : aos) {
+            energy_aos += p.mass * (p.vx * p.vx + p.vy * p.vy + p.vz * p.vz) + p.x + p.y + p.z + p.id;
+        }
+    });
+    double rows_soa = ns_per_element(n, rounds, [&] {
+        for (auto [x, y, z, vx, vy, vz, mass, id] : soa) {
+            energy_soa += mass * (vx * vx + vy * vy + vz * vz) + x + y + z + id;
+        }
+    });
+    assert(energy_aos == energy_soa);
+
+    cout << "ns per element, " << n << " particles (8 fields, 32 bytes)" << endl;
+    cout << setw(24) << "" << setw(10) << "AoS" << setw(10) << "SoA" << endl;
+    cout << fixed << setprecision(3)
+         << setw(24) << "scan id (1 field)" << setw(10) << scan_aos << setw(10) << scan_soa << endl
+         << setw(24) << "x += vx * dt (2 fields)" << setw(10) << update_aos << setw(10) << update_soa << endl
+         << setw(24) << "full rows (8 fields)" << setw(10) << rows_aos << setw(10) << rows_soa << endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    test_soa_vector_rows();
+    test_soa_vector_columns();
+    test_soa_vector_exception_safety();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_soa_vector();
+    }
+
+    return 0;
+}